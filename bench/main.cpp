@@ -0,0 +1,196 @@
+#include "intrusive.h"
+#include "pool.h"
+#include "shared.h"
+#include "unique.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+// Every hot path is measured side by side with its std:: equivalent, so a
+// regression in IncreaseStrong/DecreaseStrong or the move paths shows up as a
+// ratio shift rather than an absolute number drowned in machine noise.
+
+namespace {
+
+struct Payload {
+    char bytes[48] = {};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Construction: one combined allocation vs block + object.
+
+void BM_MakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto p = MakeShared<Payload>();
+        benchmark::DoNotOptimize(p.Get());
+    }
+}
+BENCHMARK(BM_MakeShared);
+
+void BM_StdMakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto p = std::make_shared<Payload>();
+        benchmark::DoNotOptimize(p.get());
+    }
+}
+BENCHMARK(BM_StdMakeShared);
+
+void BM_SharedPtrFromNew(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<Payload> p(new Payload);
+        benchmark::DoNotOptimize(p.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrFromNew);
+
+void BM_StdSharedPtrFromNew(benchmark::State& state) {
+    for (auto _ : state) {
+        std::shared_ptr<Payload> p(new Payload);
+        benchmark::DoNotOptimize(p.get());
+    }
+}
+BENCHMARK(BM_StdSharedPtrFromNew);
+
+////////////////////////////////////////////////////////////////////////////////
+// Copy / move / destroy of a live handle.
+
+void BM_SharedPtrCopy(benchmark::State& state) {
+    auto p = MakeShared<Payload>();
+    for (auto _ : state) {
+        SharedPtr<Payload> q = p;
+        benchmark::DoNotOptimize(q.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrCopy);
+
+void BM_StdSharedPtrCopy(benchmark::State& state) {
+    auto p = std::make_shared<Payload>();
+    for (auto _ : state) {
+        std::shared_ptr<Payload> q = p;
+        benchmark::DoNotOptimize(q.get());
+    }
+}
+BENCHMARK(BM_StdSharedPtrCopy);
+
+void BM_SharedPtrMove(benchmark::State& state) {
+    auto p = MakeShared<Payload>();
+    for (auto _ : state) {
+        SharedPtr<Payload> q = std::move(p);
+        p = std::move(q);
+        benchmark::DoNotOptimize(p.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrMove);
+
+void BM_StdSharedPtrMove(benchmark::State& state) {
+    auto p = std::make_shared<Payload>();
+    for (auto _ : state) {
+        std::shared_ptr<Payload> q = std::move(p);
+        p = std::move(q);
+        benchmark::DoNotOptimize(p.get());
+    }
+}
+BENCHMARK(BM_StdSharedPtrMove);
+
+void BM_UniquePtrMove(benchmark::State& state) {
+    UniquePtr<Payload> p(new Payload);
+    for (auto _ : state) {
+        UniquePtr<Payload> q(std::move(p));
+        p = std::move(q);
+        benchmark::DoNotOptimize(p.Get());
+    }
+}
+BENCHMARK(BM_UniquePtrMove);
+
+void BM_StdUniquePtrMove(benchmark::State& state) {
+    std::unique_ptr<Payload> p(new Payload);
+    for (auto _ : state) {
+        std::unique_ptr<Payload> q(std::move(p));
+        p = std::move(q);
+        benchmark::DoNotOptimize(p.get());
+    }
+}
+BENCHMARK(BM_StdUniquePtrMove);
+
+////////////////////////////////////////////////////////////////////////////////
+// Policy comparison: the non-atomic and biased counters against the default.
+
+void BM_SharedPtrCopySingleThreaded(benchmark::State& state) {
+    auto p = MakeShared<Payload, SingleThreaded>();
+    for (auto _ : state) {
+        SharedPtr<Payload, SingleThreaded> q = p;
+        benchmark::DoNotOptimize(q.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrCopySingleThreaded);
+
+void BM_SharedPtrCopyBiased(benchmark::State& state) {
+    auto p = MakeShared<Payload, Biased>();
+    for (auto _ : state) {
+        SharedPtr<Payload, Biased> q = p;
+        benchmark::DoNotOptimize(q.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrCopyBiased);
+
+////////////////////////////////////////////////////////////////////////////////
+// Object pool: warm reuse (freelist pop) vs cold path (make_unique).
+
+struct PooledPayload : ObjectInPool<PooledPayload>, Payload {};
+
+void BM_PoolAllocateWarm(benchmark::State& state) {
+    ObjectPool<PooledPayload> pool;
+    pool.Reserve(1);
+    for (auto _ : state) {
+        auto p = pool.Allocate();
+        benchmark::DoNotOptimize(p.Get());
+    }
+}
+BENCHMARK(BM_PoolAllocateWarm);
+
+void BM_PoolAllocateCold(benchmark::State& state) {
+    ObjectPool<PooledPayload> pool;
+    for (auto _ : state) {
+        auto p = pool.Allocate();
+        benchmark::DoNotOptimize(p.Get());
+        p.Reset();
+        pool.ShrinkToFit();  // force the next Allocate back onto the cold path
+    }
+}
+BENCHMARK(BM_PoolAllocateCold);
+
+void BM_MakeUniqueBaseline(benchmark::State& state) {
+    for (auto _ : state) {
+        auto p = std::make_unique<PooledPayload>();
+        benchmark::DoNotOptimize(p.get());
+    }
+}
+BENCHMARK(BM_MakeUniqueBaseline);
+
+////////////////////////////////////////////////////////////////////////////////
+// Contention: all threads hammer copies of one control block.
+
+void BM_SharedPtrCopyContended(benchmark::State& state) {
+    static SharedPtr<Payload> shared = MakeShared<Payload>();
+    for (auto _ : state) {
+        SharedPtr<Payload> q = shared;
+        benchmark::DoNotOptimize(q.Get());
+    }
+}
+BENCHMARK(BM_SharedPtrCopyContended)->Threads(1)->Threads(4)->Threads(16);
+
+void BM_StdSharedPtrCopyContended(benchmark::State& state) {
+    static std::shared_ptr<Payload> shared = std::make_shared<Payload>();
+    for (auto _ : state) {
+        std::shared_ptr<Payload> q = shared;
+        benchmark::DoNotOptimize(q.get());
+    }
+}
+BENCHMARK(BM_StdSharedPtrCopyContended)->Threads(1)->Threads(4)->Threads(16);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "shared.h"
+
+// Atomic holder for a SharedPtr, analogous to std::atomic<std::shared_ptr>.
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/atomic2
+//
+// Readers never block: Load() pins the current value with a CAS that bumps an
+// external count packed next to the node pointer (split reference counting),
+// copies the SharedPtr, and unpins. Writers swap the node in one exchange and
+// fold the external count into the node's internal count; whoever finishes
+// last frees the node. The 16-byte CAS is lock-free on platforms with a
+// double-width compare-exchange (cmpxchg16b on x86-64, built with -mcx16).
+template <typename T, typename Policy = MultiThreaded>
+class AtomicSharedPtr {
+private:
+    struct Node {
+        SharedPtr<T, Policy> value;
+        // Accumulates -1 per finished reader and (external - 1) from the
+        // retiring writer; the node dies when it reaches zero.
+        std::atomic<int> internal{0};
+
+        explicit Node(SharedPtr<T, Policy> v) : value(std::move(v)) { }
+    };
+
+    struct Counted {
+        Node* node;
+        // Number of references handed out through state_: the one owner
+        // reference plus one per reader that pinned this node.
+        intptr_t external;
+    };
+
+    std::atomic<Counted> state_;
+
+public:
+    AtomicSharedPtr() : state_(Counted{nullptr, 0}) { }
+
+    explicit AtomicSharedPtr(SharedPtr<T, Policy> desired)
+        : state_(Counted{new Node(std::move(desired)), 1}) { }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ~AtomicSharedPtr() {
+        Counted cur = state_.load(std::memory_order_relaxed);
+        if (cur.node) {
+            Retire(cur);
+        }
+    }
+
+    bool IsLockFree() const {
+        return state_.is_lock_free();
+    }
+
+    SharedPtr<T, Policy> Load() {
+        Counted cur = state_.load(std::memory_order_acquire);
+        while (true) {
+            if (!cur.node) {
+                return SharedPtr<T, Policy>();
+            }
+            Counted pinned{cur.node, cur.external + 1};
+            if (state_.compare_exchange_weak(cur, pinned, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+                cur = pinned;
+                break;
+            }
+        }
+        // The pin keeps cur.node alive even if a writer swaps it out now.
+        SharedPtr<T, Policy> result = cur.node->value;
+        Unpin(cur.node);
+        return result;
+    }
+
+    void Store(SharedPtr<T, Policy> desired) {
+        Exchange(std::move(desired));
+    }
+
+    SharedPtr<T, Policy> Exchange(SharedPtr<T, Policy> desired) {
+        Counted fresh{new Node(std::move(desired)), 1};
+        Counted old = state_.exchange(fresh, std::memory_order_acq_rel);
+        if (!old.node) {
+            return SharedPtr<T, Policy>();
+        }
+        // Safe to copy before retiring: we are the retirer, so the node
+        // cannot die under us.
+        SharedPtr<T, Policy> previous = old.node->value;
+        Retire(old);
+        return previous;
+    }
+
+    // Compares against `expected` by pointee identity. On failure `expected`
+    // is refreshed with the current value.
+    bool CompareExchange(SharedPtr<T, Policy>& expected, SharedPtr<T, Policy> desired) {
+        while (true) {
+            Counted cur = state_.load(std::memory_order_acquire);
+
+            if (!cur.node) {
+                if (expected.Get() != nullptr) {
+                    expected = SharedPtr<T, Policy>();
+                    return false;
+                }
+                Counted fresh{new Node(std::move(desired)), 1};
+                if (state_.compare_exchange_strong(cur, fresh, std::memory_order_acq_rel,
+                                                   std::memory_order_acquire)) {
+                    return true;
+                }
+                // Lost the race: recycle the unpublished node and retry.
+                desired = std::move(fresh.node->value);
+                delete fresh.node;
+                continue;
+            }
+
+            // Pin the node before touching it, like Load() does.
+            Counted pinned{cur.node, cur.external + 1};
+            if (!state_.compare_exchange_weak(cur, pinned, std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+                continue;
+            }
+            Node* node = pinned.node;
+
+            if (node->value.Get() != expected.Get()) {
+                expected = node->value;
+                Unpin(node);
+                return false;
+            }
+
+            // Publish. Concurrent readers keep bumping the external count, so
+            // chase the snapshot while it is still the same node.
+            Counted fresh{new Node(std::move(desired)), 1};
+            Counted snapshot = pinned;
+            bool published = false;
+            while (snapshot.node == node) {
+                if (state_.compare_exchange_weak(snapshot, fresh, std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+                    published = true;
+                    break;
+                }
+            }
+            if (published) {
+                // snapshot.external includes our own pin; Retire leaves it to
+                // the Unpin below to settle.
+                Retire(snapshot);
+                Unpin(node);
+                return true;
+            }
+            // Someone else swapped the value under us: undo and retry.
+            desired = std::move(fresh.node->value);
+            delete fresh.node;
+            Unpin(node);
+        }
+    }
+
+private:
+    static void Unpin(Node* node) {
+        if (node->internal.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    // Called exactly once per node, by the writer that removed it from
+    // state_. Folds the external count into the internal one.
+    static void Retire(Counted old) {
+        int pending_readers = static_cast<int>(old.external) - 1;
+        if (old.node->internal.fetch_add(pending_readers, std::memory_order_acq_rel) ==
+            -pending_readers) {
+            delete old.node;
+        }
+    }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "shared.h"
+
+#include <utility>
+
+// Copy-on-write handle. Readers take cheap immutable snapshots that share one
+// payload through SharedPtr; Mutate() hands out a mutable reference and clones
+// the payload first only when a snapshot (or another Cow copy) still points at
+// it, detected via UseCount() > 1. When no reader holds a reference — the
+// common case for rarely-contended write paths — mutation happens in place
+// with zero copying.
+//
+// Writers to the same Cow must be serialized externally, and a snapshot that
+// should not observe an in-place mutation must be taken before the write
+// starts; snapshots taken earlier are always safe, since Mutate() never
+// touches a payload someone else can see.
+template <typename T, typename Policy = MultiThreaded>
+class Cow {
+public:
+    Cow() : data_(MakeShared<T, Policy>()) {
+    }
+
+    explicit Cow(T value) : data_(MakeShared<T, Policy>(std::move(value))) {
+    }
+
+    // Copies share the payload; the next Mutate() on either side clones.
+    Cow(const Cow&) = default;
+    Cow(Cow&&) = default;
+    Cow& operator=(const Cow&) = default;
+    Cow& operator=(Cow&&) = default;
+
+    const T& Read() const {
+        return *data_;
+    }
+    const T& operator*() const {
+        return *data_;
+    }
+    const T* operator->() const {
+        return data_.Get();
+    }
+
+    // Immutable view that keeps the current payload alive independently of
+    // later writes.
+    SharedPtr<const T, Policy> Snapshot() const {
+        return data_;
+    }
+
+    // Mutable access; clones the payload iff somebody else still shares it.
+    T& Mutate() {
+        if (data_.UseCount() > 1) {
+            data_ = MakeShared<T, Policy>(*data_);
+        }
+        return *data_;
+    }
+
+    size_t UseCount() const {
+        return data_.UseCount();
+    }
+
+private:
+    SharedPtr<T, Policy> data_;
+};
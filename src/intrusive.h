@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>  // std::nullptr_t
+#include <utility>  // std::forward, std::swap
+
+// Intrusive reference counting: the count lives inside the object, so the
+// handle is one word and copying it never allocates. Any type with
+// IncRef()/DecRef()/RefCount() works (see ObjectInPool in the tests for a
+// pool-recycling counter); SimpleRefCounted is the ready-made delete-on-zero
+// base.
+
+template <typename T>
+struct DefaultDelete {
+    static void Destroy(T* object) {
+        delete object;
+    }
+};
+
+template <typename Derived, typename Deleter = DefaultDelete<Derived>>
+class SimpleRefCounted {
+public:
+    SimpleRefCounted() = default;
+
+    // Copying an object must not copy its reference count.
+    SimpleRefCounted(const SimpleRefCounted&) {
+    }
+    SimpleRefCounted& operator=(const SimpleRefCounted&) {
+        return *this;
+    }
+
+    void IncRef() {
+        ++count_;
+    }
+
+    void DecRef() {
+        if (--count_ == 0) {
+            Deleter::Destroy(static_cast<Derived*>(this));
+        }
+    }
+
+    size_t RefCount() const {
+        return count_;
+    }
+
+private:
+    size_t count_ = 0;
+};
+
+
+template <typename T>
+class IntrusivePtr {
+private:
+    T* ptr_ = nullptr;
+
+    template <typename Y>
+    friend class IntrusivePtr;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    IntrusivePtr() = default;
+
+    IntrusivePtr(std::nullptr_t) {
+    }
+
+    IntrusivePtr(T* ptr) : ptr_(ptr) {
+        if (ptr_) {
+            ptr_->IncRef();
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
+        if (ptr_) {
+            ptr_->IncRef();
+        }
+    }
+
+    IntrusivePtr(IntrusivePtr&& other) : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    template <typename Y>
+    IntrusivePtr(const IntrusivePtr<Y>& other) : ptr_(other.ptr_) {
+        if (ptr_) {
+            ptr_->IncRef();
+        }
+    }
+
+    template <typename Y>
+    IntrusivePtr(IntrusivePtr<Y>&& other) : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    IntrusivePtr& operator=(const IntrusivePtr& other) {
+        IntrusivePtr(other).Swap(*this);
+        return *this;
+    }
+
+    IntrusivePtr& operator=(IntrusivePtr&& other) {
+        IntrusivePtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    IntrusivePtr& operator=(const IntrusivePtr<Y>& other) {
+        IntrusivePtr(other).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    IntrusivePtr& operator=(IntrusivePtr<Y>&& other) {
+        IntrusivePtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~IntrusivePtr() {
+        if (ptr_) {
+            ptr_->DecRef();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (ptr_) {
+            ptr_->DecRef();
+        }
+        ptr_ = nullptr;
+    }
+
+    void Reset(T* ptr) {
+        IntrusivePtr(ptr).Swap(*this);
+    }
+
+    void Swap(IntrusivePtr& other) {
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    size_t UseCount() const {
+        return ptr_ ? ptr_->RefCount() : 0;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+};
+
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusive(Args&&... args) {
+    return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
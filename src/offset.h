@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// Self-relative pointers for memory-mapped arenas. An OffsetPtr stores the
+// distance from its own address to the pointee instead of an absolute
+// address, so a whole object graph inside one mapping stays valid at
+// whatever base address the OS hands back on the next mmap — no
+// deserialization pass, no pointer fixups. The observer surface matches
+// UniquePtr (Get()/operator*/operator->/operator bool) so call sites read
+// the same.
+
+template <typename T>
+class OffsetPtr {
+public:
+    OffsetPtr() : offset_(0) {
+    }
+
+    OffsetPtr(std::nullptr_t) : offset_(0) {
+    }
+
+    OffsetPtr(T* ptr) {
+        Set(ptr);
+    }
+
+    // Copies rebase: the raw pointee is re-encoded relative to the new home,
+    // which is what makes assignment across the arena safe.
+    OffsetPtr(const OffsetPtr& other) {
+        Set(other.Get());
+    }
+
+    OffsetPtr& operator=(const OffsetPtr& other) {
+        Set(other.Get());
+        return *this;
+    }
+
+    OffsetPtr& operator=(T* ptr) {
+        Set(ptr);
+        return *this;
+    }
+
+    OffsetPtr& operator=(std::nullptr_t) {
+        offset_ = 0;
+        return *this;
+    }
+
+    T* Get() const {
+        if (offset_ == 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(
+            const_cast<char*>(reinterpret_cast<const char*>(this)) + offset_);
+    }
+
+    T& operator*() const {
+        return *Get();
+    }
+
+    T* operator->() const {
+        return Get();
+    }
+
+    explicit operator bool() const {
+        return offset_ != 0;
+    }
+
+private:
+    void Set(const T* ptr) {
+        // A pointer can never point at its own storage, so 0 is free to mean
+        // null.
+        offset_ = ptr ? reinterpret_cast<const char*>(ptr) - reinterpret_cast<const char*>(this)
+                      : 0;
+    }
+
+    std::ptrdiff_t offset_;
+};
+
+template <typename T, typename U>
+bool operator==(const OffsetPtr<T>& left, const OffsetPtr<U>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename U>
+bool operator!=(const OffsetPtr<T>& left, const OffsetPtr<U>& right) {
+    return !(left == right);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Fixed header at the start of a mapped file; everything after it is bump-
+// allocated object storage. All bookkeeping is offsets from the arena base,
+// so the header itself is position-independent too.
+struct ArenaHeader {
+    static constexpr uint64_t kMagic = 0x414e455241'5053;  // "SP" "ARENA"
+
+    uint64_t magic;
+    uint64_t capacity;  // total bytes, header included
+    uint64_t used;      // bump cursor, offset from the arena base
+    uint64_t root;      // offset of the root object; 0 = none
+};
+
+// Non-owning view over one contiguous mapping (the caller does the mmap and
+// keeps it alive). Create() formats a fresh buffer; Attach() validates and
+// reopens an existing one zero-copy. Objects placed with New() must be
+// trivially destructible or have their destructors managed by the caller —
+// the arena never runs them, its lifetime is the file's.
+class Arena {
+public:
+    // Formats `capacity` bytes at `base` as an empty arena.
+    static Arena Create(void* base, size_t capacity) {
+        auto* header = ::new (base) ArenaHeader{ArenaHeader::kMagic, capacity,
+                                                AlignUp(sizeof(ArenaHeader)), 0};
+        return Arena(header);
+    }
+
+    // Reopens a previously formatted mapping; returns a detached view (with
+    // Valid() == false) when the header does not check out.
+    static Arena Attach(void* base) {
+        auto* header = static_cast<ArenaHeader*>(base);
+        if (header->magic != ArenaHeader::kMagic) {
+            return Arena(nullptr);
+        }
+        return Arena(header);
+    }
+
+    bool Valid() const {
+        return header_ != nullptr;
+    }
+
+    // Bump-allocates and constructs one U; nullptr when the arena is full.
+    // U must only hold position-independent members (OffsetPtr, scalars).
+    template <typename U, typename... Args>
+    U* New(Args&&... args) {
+        void* spot = AllocateRaw(sizeof(U), alignof(U));
+        if (!spot) {
+            return nullptr;
+        }
+        return ::new (spot) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void SetRoot(U* root) {
+        header_->root = root ? reinterpret_cast<char*>(root) - Base() : 0;
+    }
+
+    template <typename U>
+    U* Root() const {
+        if (header_->root == 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<U*>(Base() + header_->root);
+    }
+
+    size_t Used() const {
+        return header_->used;
+    }
+
+    size_t Capacity() const {
+        return header_->capacity;
+    }
+
+private:
+    explicit Arena(ArenaHeader* header) : header_(header) {
+    }
+
+    static constexpr size_t AlignUp(size_t n, size_t alignment = alignof(std::max_align_t)) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    char* Base() const {
+        return reinterpret_cast<char*>(header_);
+    }
+
+    void* AllocateRaw(size_t size, size_t alignment) {
+        size_t offset = AlignUp(header_->used, alignment);
+        if (offset + size > header_->capacity) {
+            return nullptr;
+        }
+        header_->used = offset + size;
+        return Base() + offset;
+    }
+
+    ArenaHeader* header_;
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+// Compile-time-optional instrumentation for the pointer hot paths. Build with
+// -DPOINTER_STATS_ENABLED to collect, per process: control-block allocations
+// (broken down by pointee type), live and peak SharedPtr/UniquePtr handle
+// counts, refcount increment/decrement totals, and the number of contended
+// decrements in the atomic mode. Read everything at once through
+// PointerStats::Snapshot().
+//
+// Without the define every hook is an empty inline function and the trackers
+// are empty bases, so instrumented builds and production builds share the
+// same headers and the disabled form compiles to nothing.
+
+#include <cstddef>
+
+#ifdef POINTER_STATS_ENABLED
+
+#include <atomic>
+#include <typeinfo>
+
+class PointerStats {
+public:
+    // One registry node per pointee type; nodes live for the whole process
+    // and are chained so Snapshot() can walk them without a lock.
+    struct TypeCounters {
+        const char* type_name = nullptr;
+        std::atomic<size_t> control_block_allocs{0};
+        TypeCounters* next = nullptr;
+    };
+
+    struct Counters {
+        size_t control_block_allocs = 0;
+        size_t live_shared = 0;
+        size_t peak_shared = 0;
+        size_t live_unique = 0;
+        size_t peak_unique = 0;
+        size_t increments = 0;
+        size_t decrements = 0;
+        size_t contended_decrements = 0;
+        // Head of the per-type chain; entries only ever grow.
+        const TypeCounters* per_type = nullptr;
+    };
+
+    static Counters Snapshot() {
+        Counters out;
+        out.control_block_allocs = control_block_allocs_.load(std::memory_order_relaxed);
+        out.live_shared = live_shared_.load(std::memory_order_relaxed);
+        out.peak_shared = peak_shared_.load(std::memory_order_relaxed);
+        out.live_unique = live_unique_.load(std::memory_order_relaxed);
+        out.peak_unique = peak_unique_.load(std::memory_order_relaxed);
+        out.increments = increments_.load(std::memory_order_relaxed);
+        out.decrements = decrements_.load(std::memory_order_relaxed);
+        out.contended_decrements = contended_decrements_.load(std::memory_order_relaxed);
+        out.per_type = registry_.load(std::memory_order_acquire);
+        return out;
+    }
+
+    template <class T>
+    static void OnControlBlockAlloc() {
+        control_block_allocs_.fetch_add(1, std::memory_order_relaxed);
+        Entry<T>().control_block_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void OnIncrement() {
+        increments_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void OnDecrement() {
+        decrements_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void OnContendedDecrement() {
+        contended_decrements_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void OnSharedCreated() {
+        BumpLive(live_shared_, peak_shared_);
+    }
+    static void OnSharedDestroyed() {
+        live_shared_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void OnUniqueCreated() {
+        BumpLive(live_unique_, peak_unique_);
+    }
+    static void OnUniqueDestroyed() {
+        live_unique_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+private:
+    static void BumpLive(std::atomic<size_t>& live, std::atomic<size_t>& peak) {
+        size_t now = live.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t seen = peak.load(std::memory_order_relaxed);
+        while (now > seen &&
+               !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    template <class T>
+    static TypeCounters& Entry() {
+        // Registered once per type, lives until process exit (deliberately
+        // never freed: Snapshot() readers may hold the chain at any time).
+        static TypeCounters& entry = Register(typeid(T).name());
+        return entry;
+    }
+
+    static TypeCounters& Register(const char* name) {
+        auto* entry = new TypeCounters;
+        entry->type_name = name;
+        entry->next = registry_.load(std::memory_order_relaxed);
+        while (!registry_.compare_exchange_weak(entry->next, entry, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        return *entry;
+    }
+
+    static inline std::atomic<size_t> control_block_allocs_{0};
+    static inline std::atomic<size_t> live_shared_{0};
+    static inline std::atomic<size_t> peak_shared_{0};
+    static inline std::atomic<size_t> live_unique_{0};
+    static inline std::atomic<size_t> peak_unique_{0};
+    static inline std::atomic<size_t> increments_{0};
+    static inline std::atomic<size_t> decrements_{0};
+    static inline std::atomic<size_t> contended_decrements_{0};
+    static inline std::atomic<TypeCounters*> registry_{nullptr};
+};
+
+#else  // !POINTER_STATS_ENABLED
+
+class PointerStats {
+public:
+    struct TypeCounters {
+        const char* type_name = nullptr;
+        const TypeCounters* next = nullptr;
+    };
+
+    struct Counters {
+        size_t control_block_allocs = 0;
+        size_t live_shared = 0;
+        size_t peak_shared = 0;
+        size_t live_unique = 0;
+        size_t peak_unique = 0;
+        size_t increments = 0;
+        size_t decrements = 0;
+        size_t contended_decrements = 0;
+        const TypeCounters* per_type = nullptr;
+    };
+
+    static Counters Snapshot() {
+        return {};
+    }
+
+    template <class T>
+    static void OnControlBlockAlloc() {
+    }
+    static void OnIncrement() {
+    }
+    static void OnDecrement() {
+    }
+    static void OnContendedDecrement() {
+    }
+    static void OnSharedCreated() {
+    }
+    static void OnSharedDestroyed() {
+    }
+    static void OnUniqueCreated() {
+    }
+    static void OnUniqueDestroyed() {
+    }
+};
+
+#endif  // POINTER_STATS_ENABLED
+
+// Empty bases for the handle types: every constructor of the deriving class
+// constructs them, so live/peak tracking needs no per-constructor hooks.
+// With stats disabled the calls inline away and the bases occupy no storage.
+
+struct SharedHandleTracker {
+    SharedHandleTracker() {
+        PointerStats::OnSharedCreated();
+    }
+    SharedHandleTracker(const SharedHandleTracker&) {
+        PointerStats::OnSharedCreated();
+    }
+    SharedHandleTracker& operator=(const SharedHandleTracker&) {
+        return *this;
+    }
+    ~SharedHandleTracker() {
+        PointerStats::OnSharedDestroyed();
+    }
+};
+
+struct UniqueHandleTracker {
+    UniqueHandleTracker() {
+        PointerStats::OnUniqueCreated();
+    }
+    UniqueHandleTracker(const UniqueHandleTracker&) {
+        PointerStats::OnUniqueCreated();
+    }
+    UniqueHandleTracker& operator=(const UniqueHandleTracker&) {
+        return *this;
+    }
+    ~UniqueHandleTracker() {
+        PointerStats::OnUniqueDestroyed();
+    }
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "intrusive.h"  // IntrusivePtr
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+template <typename T>
+class ObjectPool;
+
+// Counting base for pooled objects: the last DecRef() returns the object to
+// its home pool instead of deleting it. The count is atomic so handles may be
+// copied and dropped from any thread.
+template <typename Derived>
+class ObjectInPool {
+public:
+    void IncRef() {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void DecRef() {
+        if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            TakeMeHome();
+        }
+    }
+
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    void SetHome(ObjectPool<Derived>* pool) {
+        home_ = pool;
+    }
+
+private:
+    friend class ObjectPool<Derived>;
+
+    void TakeMeHome() {
+        home_->Release(static_cast<Derived*>(this));
+    }
+
+    std::atomic<size_t> count_{0};
+    ObjectPool<Derived>* home_ = nullptr;
+    // Freelist link; atomic because a concurrent pop may chase it while a
+    // re-push of the same object rewrites it.
+    std::atomic<ObjectInPool*> free_next_{nullptr};
+};
+
+
+// Recycles objects through a lock-free Treiber stack, so Allocate()/Release()
+// are allocation-free and contention is a single CAS once the pool is warm.
+// The version tag beside the head pointer guards against ABA; 16-byte CAS,
+// lock-free with a double-width compare-exchange (-mcx16 on x86-64).
+// The pool must outlive every handle it issued.
+template <typename T>
+class ObjectPool {
+    static_assert(std::is_base_of_v<ObjectInPool<T>, T>, "Unsupported type");
+
+public:
+    ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        DeleteChain(head_.load(std::memory_order_relaxed).node);
+        DeleteChain(limbo_.exchange(nullptr, std::memory_order_relaxed));
+    }
+
+    template <typename... Args>
+    IntrusivePtr<T> Allocate(Args&&... args) {
+        if (T* recycled = PopFree()) {
+            return IntrusivePtr<T>(recycled);
+        }
+        return DoAllocate(std::forward<Args>(args)...);
+    }
+
+    // Pre-constructs objects until `count` are idle, so the first `count`
+    // Allocate() calls after startup are allocation-free. Args are copied
+    // into every constructed object. Clamped to the idle cap: past it,
+    // Release() discards on sight, so reserving more would spin forever.
+    template <typename... Args>
+    void Reserve(size_t count, const Args&... args) {
+        count = std::min(count, max_idle_.load(std::memory_order_relaxed));
+        while (NumAvailable() < count) {
+            // Parked directly in the freelist, bypassing the Release() path
+            // (and its cap check) that a dropped handle would take.
+            allocated_.fetch_add(1, std::memory_order_relaxed);
+            std::unique_ptr<T> object = std::make_unique<T>(args...);
+            object->SetHome(this);
+            PushFree(object.release());
+        }
+    }
+
+    // Caps the number of idle objects the pool keeps; objects released past
+    // the cap go back to the allocator, so steady-state memory tracks load
+    // instead of the historical peak. The cap is advisory under concurrent
+    // releases (the counter check is not atomic with the push).
+    void SetMaxIdle(size_t cap) {
+        max_idle_.store(cap, std::memory_order_relaxed);
+    }
+
+    // Returns idle objects beyond `keep` to the allocator. Concurrent
+    // Allocate()/Release() are fine; this only competes for idle objects.
+    void ShrinkToFit(size_t keep = 0) {
+        while (NumAvailable() > keep) {
+            T* idle = PopFree();
+            if (!idle) {
+                break;
+            }
+            Discard(idle);
+        }
+    }
+
+    void Release(T* ptr) {
+        if (NumAvailable() >= max_idle_.load(std::memory_order_relaxed)) {
+            Discard(ptr);
+            return;
+        }
+        PushFree(ptr);
+    }
+
+    // Returns a burst of idle objects with a single CAS instead of one per
+    // object: the chain is linked privately first, then spliced onto the
+    // freelist in one shot. Accepts both pool-origin objects (refcount
+    // drained to zero) and freshly constructed ones, which are adopted.
+    void ReleaseBatch(T* const* ptrs, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        size_t adopted = 0;
+        for (size_t i = 0; i < count; ++i) {
+            ObjectInPool<T>* node = ptrs[i];
+            if (node->home_ == nullptr) {
+                node->home_ = this;
+                ++adopted;
+            }
+            if (i + 1 < count) {
+                node->free_next_.store(ptrs[i + 1], std::memory_order_relaxed);
+            }
+        }
+        if (adopted > 0) {
+            allocated_.fetch_add(adopted, std::memory_order_relaxed);
+        }
+        ObjectInPool<T>* first = ptrs[0];
+        ObjectInPool<T>* last = ptrs[count - 1];
+        Head cur = head_.load(std::memory_order_relaxed);
+        while (true) {
+            last->free_next_.store(cur.node, std::memory_order_relaxed);
+            Head next{first, cur.tag};
+            if (head_.compare_exchange_weak(cur, next, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        available_.fetch_add(count, std::memory_order_relaxed);
+        size_t cap = max_idle_.load(std::memory_order_relaxed);
+        if (NumAvailable() > cap) {
+            ShrinkToFit(cap);
+        }
+    }
+
+    void ReleaseBatch(const std::vector<T*>& ptrs) {
+        ReleaseBatch(ptrs.data(), ptrs.size());
+    }
+
+    size_t NumAvailable() const {
+        return available_.load(std::memory_order_relaxed);
+    }
+
+    size_t NumInUse() const {
+        return allocated_.load(std::memory_order_relaxed) - NumAvailable();
+    }
+
+private:
+    struct Head {
+        ObjectInPool<T>* node;
+        // Bumped on every pop so a pop/push/pop of the same object cannot
+        // fool a concurrent CAS (ABA).
+        uintptr_t tag;
+    };
+
+    T* PopFree() {
+        // Announce ourselves so Discard() knows a stale head snapshot may
+        // still chase free_next_ of an already-unlinked node.
+        poppers_.fetch_add(1, std::memory_order_acquire);
+        T* taken = nullptr;
+        Head cur = head_.load(std::memory_order_acquire);
+        while (cur.node) {
+            // Safe to chase free_next_: unlinked objects sit in the limbo
+            // list until no pop is in flight, and the tag invalidates stale
+            // snapshots.
+            Head next{cur.node->free_next_.load(std::memory_order_acquire), cur.tag + 1};
+            if (head_.compare_exchange_weak(cur, next, std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+                available_.fetch_sub(1, std::memory_order_relaxed);
+                taken = static_cast<T*>(cur.node);
+                break;
+            }
+        }
+        poppers_.fetch_sub(1, std::memory_order_release);
+        return taken;
+    }
+
+    void PushFree(T* ptr) {
+        ObjectInPool<T>* node = ptr;
+        Head cur = head_.load(std::memory_order_relaxed);
+        while (true) {
+            node->free_next_.store(cur.node, std::memory_order_relaxed);
+            Head next{node, cur.tag};
+            if (head_.compare_exchange_weak(cur, next, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                available_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // Hands an unlinked object back to the allocator. Deleting right away
+    // would race with a popper whose head snapshot predates the unlink, so
+    // objects park in a limbo list until no pop is in flight.
+    void Discard(T* ptr) {
+        allocated_.fetch_sub(1, std::memory_order_relaxed);
+        ObjectInPool<T>* node = ptr;
+        ObjectInPool<T>* cur = limbo_.load(std::memory_order_relaxed);
+        do {
+            node->free_next_.store(cur, std::memory_order_relaxed);
+        } while (!limbo_.compare_exchange_weak(cur, node, std::memory_order_release,
+                                               std::memory_order_relaxed));
+        if (poppers_.load(std::memory_order_acquire) == 0) {
+            // No pop in flight and limbo nodes are unreachable from head_,
+            // so nobody can touch them anymore.
+            DeleteChain(limbo_.exchange(nullptr, std::memory_order_acq_rel));
+        }
+    }
+
+    static void DeleteChain(ObjectInPool<T>* node) {
+        while (node) {
+            ObjectInPool<T>* next = node->free_next_.load(std::memory_order_relaxed);
+            delete static_cast<T*>(node);
+            node = next;
+        }
+    }
+
+    template <typename... Args>
+    IntrusivePtr<T> DoAllocate(Args&&... args) {
+        allocated_.fetch_add(1, std::memory_order_relaxed);
+        std::unique_ptr<T> object = std::make_unique<T>(std::forward<Args>(args)...);
+        object->SetHome(this);
+        return IntrusivePtr<T>(object.release());
+    }
+
+    std::atomic<Head> head_{Head{nullptr, 0}};
+    std::atomic<size_t> allocated_{0};
+    std::atomic<size_t> available_{0};
+    std::atomic<size_t> max_idle_{static_cast<size_t>(-1)};
+    std::atomic<ObjectInPool<T>*> limbo_{nullptr};
+    std::atomic<size_t> poppers_{0};
+};
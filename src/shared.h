@@ -1,125 +1,911 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
-#include <cstddef>  // std::nullptr_t
-#include <memory>   // std::destroy_at
+#include "pointer_stats.h"  // Optional instrumentation; no-ops unless enabled
+#include <atomic>       // std::atomic
+#include <cstddef>      // std::nullptr_t
+#include <memory>       // std::destroy_at
+#include <new>          // std::align_val_t
+#include <thread>       // std::this_thread::get_id
+#include <type_traits>  // std::is_convertible_v
+#include <vector>       // MakeSharedBatch result
 
+// Raw storage for combined block+object allocations. Plain operator new only
+// guarantees __STDCPP_DEFAULT_NEW_ALIGNMENT__, so blocks embedding an
+// overaligned T (cache-line- or AVX-512-aligned state) route through the
+// align_val_t overloads; everything else stays on the default path.
+inline void* AllocateBlockStorage(size_t size, size_t alignment) {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        return ::operator new(size, std::align_val_t(alignment));
+    }
+    return ::operator new(size);
+}
+
+inline void DeallocateBlockStorage(void* p, size_t alignment) {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+        ::operator delete(p, std::align_val_t(alignment));
+        return;
+    }
+    ::operator delete(p);
+}
+
+// Threading policies select the counter implementation in ControlBlockBase at
+// compile time. MultiThreaded (the default) uses relaxed increments and
+// acquire-release decrements so SharedPtr copies can be handed across threads
+// without external locking. SingleThreaded keeps plain ints for code that is
+// pinned to one thread and does not want to pay for atomic RMWs.
+
+struct SingleThreaded {
+    // Count n is stored as 2n + 1, so the word reads odd for as long as the
+    // block can still be promoted; see ControlBlockBase::deferred_next for
+    // what overlays this storage once the count is gone.
+    struct Counter {
+        int value;
+
+        Counter(int initial) : value(2 * initial + 1) {
+        }
+    };
+
+    static void Increment(Counter& c) {
+        c.value += 2;
+    }
+
+    // Returns true when the count dropped to zero.
+    static bool Decrement(Counter& c) {
+        return (c.value -= 2) == 1;
+    }
+
+    static int Load(const Counter& c) {
+        return (c.value & 1) ? c.value >> 1 : 0;
+    }
+
+    // Returns false if the count was already zero.
+    static bool IncrementIfNonZero(Counter& c) {
+        if (!(c.value & 1) || c.value == 1) {
+            return false;
+        }
+        c.value += 2;
+        return true;
+    }
+};
+
+struct MultiThreaded {
+    // Count n is stored as 2n + 1, odd while the block can still be
+    // promoted; see ControlBlockBase::deferred_next for what overlays this
+    // storage once the count is gone.
+    struct Counter {
+        std::atomic<int> value;
+
+        Counter(int initial) : value(2 * initial + 1) {
+        }
+    };
+
+    static void Increment(Counter& c) {
+        c.value.fetch_add(2, std::memory_order_relaxed);
+    }
+
+    // Returns true when the count dropped to zero.
+    static bool Decrement(Counter& c) {
+#ifdef POINTER_STATS_ENABLED
+        // CAS instead of fetch_sub so a failed exchange — another thread got
+        // in between — is observable as one contended decrement.
+        int cur = c.value.load(std::memory_order_relaxed);
+        while (!c.value.compare_exchange_weak(cur, cur - 2, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+            PointerStats::OnContendedDecrement();
+        }
+        return cur == 3;
+#else
+        return c.value.fetch_sub(2, std::memory_order_acq_rel) == 3;
+#endif
+    }
+
+    static int Load(const Counter& c) {
+        int v = c.value.load(std::memory_order_relaxed);
+        return (v & 1) ? v >> 1 : 0;
+    }
+
+    // Lock-free: CAS loop that bumps the count unless it already hit zero
+    // (an even read means the count is gone and the storage reused). This is
+    // what makes WeakPtr::Lock() safe without taking any lock.
+    static bool IncrementIfNonZero(Counter& c) {
+        int cur = c.value.load(std::memory_order_relaxed);
+        while ((cur & 1) && cur != 1) {
+            if (c.value.compare_exchange_weak(cur, cur + 2, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Biased counting: references taken on the thread that created the control
+// block use a plain count that only the owner touches (no atomic RMW);
+// every other thread goes through an atomic shared count. Bit 0 of the shared
+// word is the bias flag, set while the owner still holds local references;
+// the remaining bits hold the shared count, which goes negative when
+// locally-counted references migrate to other threads and die there. Because
+// the total is split across two words, a decrement publishes its own death
+// first and only then reads the other side's count (seq_cst both ways, so of
+// two racing last decrements at least one observes the drained total), and
+// the claim itself is a CAS on the shared word, so exactly one side destroys.
+// Gives single-threaded copy speed with multi-threaded correctness for
+// workloads where cross-thread sharing is the exception.
+struct Biased {
+    static constexpr int kBiasFlag = 1;
+
+    struct Counter {
+        // First on purpose: the deferred-reclaim link overlays the leading
+        // pointer-width bytes of the counter (see ControlBlockBase), and the
+        // owner id is the one word nothing consults once the count drains.
+        std::thread::id owner;
+        static_assert(sizeof(std::thread::id) >= sizeof(void*));
+        // Owner-only writes; atomic so foreign reconciliation reads are
+        // race-free, but the owner never pays an RMW for it.
+        std::atomic<int> local;
+        std::atomic<int> shared;
+        // Foreign threads reconciling a deficit announce themselves here; a
+        // claimant waits for them to leave before reporting the count dead,
+        // so nobody reads a counter the caller is about to free.
+        std::atomic<int> reconcilers{0};
+        // Odd while the owner's decrement is touching the shared word after
+        // publishing its count; claimants wait for it to close likewise.
+        std::atomic<unsigned> owner_window{0};
+
+        Counter(int initial)
+            : owner(std::this_thread::get_id()), local(initial), shared(kBiasFlag) {
+        }
+
+        bool IsOwner() const {
+            return std::this_thread::get_id() == owner;
+        }
+
+        int LocalGet() const {
+            return local.load(std::memory_order_relaxed);
+        }
+
+        void LocalSet(int v) {
+            local.store(v, std::memory_order_relaxed);
+        }
+    };
+
+    static void Increment(Counter& c) {
+        if (c.IsOwner() && c.LocalGet() > 0) {
+            c.LocalSet(c.LocalGet() + 1);
+            return;
+        }
+        c.shared.fetch_add(2, std::memory_order_relaxed);
+    }
+
+    static bool Decrement(Counter& c) {
+        if (c.IsOwner() && c.LocalGet() > 0) {
+            int l = c.LocalGet() - 1;
+            if (l == 0) {
+                // Only our own last reference is local-counted here (migrated
+                // ones would hold the count above one), so there is no
+                // deficit to reconcile: drop the bias, dead if no shared refs.
+                c.LocalSet(0);
+                if (c.shared.fetch_sub(kBiasFlag, std::memory_order_acq_rel) == kBiasFlag) {
+                    AwaitQuiescence(c);
+                    return true;
+                }
+                return false;
+            }
+            // Publish the decremented count first, then check the shared word
+            // for a deficit left by locally-counted references that migrated
+            // and died on other threads. Checking before publishing left a
+            // window where a racing foreign death read the stale count, both
+            // sides returned "not last", and the object leaked. The window
+            // marker stays odd while we touch the word after publishing: a
+            // claimant that drained our published count waits for it to
+            // close, so the block cannot be freed under these reads.
+            unsigned window = c.owner_window.load(std::memory_order_relaxed);
+            c.owner_window.store(window + 1, std::memory_order_relaxed);
+            c.local.store(l, std::memory_order_seq_cst);
+            int s = c.shared.load(std::memory_order_seq_cst);
+            bool dead = false;
+            while ((s & kBiasFlag) && (s >> 1) < 0) {
+                // Deficit: fold the rest of the local count in and drop the
+                // bias, so the word alone arbitrates from here on — possibly
+                // dead right now, by our own hand.
+                int folded = s + (l << 1) - kBiasFlag;
+                if (c.shared.compare_exchange_weak(s, folded, std::memory_order_seq_cst,
+                                                   std::memory_order_seq_cst)) {
+                    c.LocalSet(0);
+                    dead = folded == 0;
+                    break;
+                }
+            }
+            c.owner_window.store(window + 2, std::memory_order_release);
+            if (dead) {
+                AwaitQuiescence(c);
+            }
+            return dead;
+        }
+
+        int cur = c.shared.load(std::memory_order_acquire);
+        while (true) {
+            if (!(cur & kBiasFlag) || (cur >> 1) > 0) {
+                if (c.shared.compare_exchange_weak(cur, cur - 2, std::memory_order_acq_rel,
+                                                   std::memory_order_acquire)) {
+                    // With the flag still set the owner holds local refs
+                    // (the flag is cleared exactly when they drain), so the
+                    // object is alive; with it clear, dead at count zero.
+                    if (!(cur & kBiasFlag) && cur == 2) {
+                        AwaitQuiescence(c);
+                        return true;
+                    }
+                    return false;
+                }
+                continue;
+            }
+            // Flag set but the shared count would go negative: a reference
+            // counted in the owner's local count is dying on this thread (it
+            // migrated here). Announce first — a claimant waits for us before
+            // letting the caller free the block — then record the death, then
+            // read the local count. Record-then-read mirrors the owner's
+            // publish-then-check, so when the two sides drain concurrently at
+            // least one of them computes a zero total and claims it.
+            c.reconcilers.fetch_add(1, std::memory_order_seq_cst);
+            cur = c.shared.load(std::memory_order_seq_cst);
+            if (!(cur & kBiasFlag) || (cur >> 1) > 0) {
+                c.reconcilers.fetch_sub(1, std::memory_order_release);
+                continue;
+            }
+            if (!c.shared.compare_exchange_strong(cur, cur - 2, std::memory_order_seq_cst,
+                                                  std::memory_order_seq_cst)) {
+                c.reconcilers.fetch_sub(1, std::memory_order_release);
+                continue;
+            }
+            int total = c.local.load(std::memory_order_seq_cst) + (cur >> 1) - 1;
+            bool dead = false;
+            if (total == 0) {
+                // Drained: claim destruction by zeroing the word. Losing this
+                // CAS means the word moved again, and whoever moved it sees
+                // our recorded death and reconciles in turn.
+                int expected = cur - 2;
+                dead = c.shared.compare_exchange_strong(expected, 0, std::memory_order_seq_cst,
+                                                        std::memory_order_seq_cst);
+            }
+            c.reconcilers.fetch_sub(1, std::memory_order_release);
+            if (dead) {
+                AwaitQuiescence(c);
+            }
+            return dead;
+        }
+    }
+
+    // A claimant reports the count dead only once every thread that may
+    // still touch it has left: foreign reconcilers drain their announce
+    // count and the owner closes its decrement window. Both windows are a
+    // handful of instructions long, so this is a short bounded spin.
+    static void AwaitQuiescence(const Counter& c) {
+        while (c.reconcilers.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        while (c.owner_window.load(std::memory_order_acquire) & 1) {
+            std::this_thread::yield();
+        }
+    }
+
+    static int Load(const Counter& c) {
+        int s = c.shared.load(std::memory_order_relaxed);
+        return (s >> 1) + ((s & kBiasFlag) ? c.LocalGet() : 0);
+    }
+
+    static bool IncrementIfNonZero(Counter& c) {
+        // Deliberately no owner-local fast path: the claim-destruction paths
+        // in Decrement() race only on the shared word, so a promotion that
+        // trusted the (possibly stale) local count could resurrect an object
+        // another thread just freed. Promotion is cold next to plain copies;
+        // it can afford the CAS. A set bias flag alone means the owner still
+        // holds local references, so a shared reference may be added even
+        // when the shared count is zero.
+        int cur = c.shared.load(std::memory_order_relaxed);
+        while (cur != 0) {
+            if (c.shared.compare_exchange_weak(cur, cur + 2, std::memory_order_acq_rel,
+                                               std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+template <class Policy>
+class DeferredQueue;
+
+// Opt-in deferred destruction (per thread): while enabled, a strong count
+// hitting zero pushes the control block onto a lock-free queue instead of
+// running the destructor cascade inline, so dropping the root of a deep
+// object graph costs one queue push on the hot thread. Destruction then runs
+// wherever DrainDeferred() is called (a background thread's tick, typically).
+inline bool& DeferredReclaimFlag() {
+    static thread_local bool enabled = false;
+    return enabled;
+}
+
+inline void SetDeferredReclaim(bool on) {
+    DeferredReclaimFlag() = on;
+}
+
+// Destruction is a single type-erased thunk chosen at construction time
+// instead of virtual OnZeroStrong()/OnZeroWeak(): the block carries one plain
+// function pointer where the vptr used to be, so the size stays flat and the
+// refcount-to-zero path is a direct indirect call the branch predictor can
+// learn, not a vtable load plus dispatch.
+template <class Policy>
 struct ControlBlockBase {
-    int strong = 0;
-    int weak = 0;
+    enum class Phase {
+        kZeroStrong,  // strong count hit zero: destroy the object
+        kZeroWeak,    // weak count hit zero: free the block itself
+    };
+    using DestroyFn = void (*)(ControlBlockBase*, Phase);
 
-    ControlBlockBase(int s, int w) : strong(s), weak(w) { }
+    union {
+        typename Policy::Counter strong;
+        // Intrusive hook for DeferredQueue, overlaying the dead strong
+        // counter instead of costing every block 8 bytes: it is only written
+        // once the strong count has drained for good. A stale WeakPtr
+        // promotion may still read the overlaid storage, so each policy
+        // keeps that read harmless — the flat policies store counts as
+        // 2n + 1, which the pointer-aligned link (always even) can never
+        // fake, and Biased arbitrates promotion through its shared word,
+        // which the link (covering only the dead owner id) never touches.
+        ControlBlockBase* deferred_next;
+    };
+    typename Policy::Counter weak;
+    DestroyFn destroy;
+
+    ControlBlockBase(int s, int w, DestroyFn d) : strong(s), weak(w), destroy(d) { }
 
     void IncreaseStrong() {
-        ++strong;
+        PointerStats::OnIncrement();
+        Policy::Increment(strong);
     }
 
     int UseCount() const {
-        return strong;
+        return Policy::Load(strong);
     }
 
+    // The whole group of strong owners holds one weak reference (blocks start
+    // at strong = 1, weak = 1), so the block stays alive while any WeakPtr
+    // can still observe it.
     void DecreaseStrong() {
-        --strong;
-        if (!strong) {
+        PointerStats::OnDecrement();
+        if (Policy::Decrement(strong)) {
+            if (DeferredReclaimFlag()) {
+                DeferredQueue<Policy>::Instance().Push(this);
+                return;
+            }
             OnZeroStrong();
+            DecreaseWeak();
+        }
+    }
+
+    bool TryIncreaseStrong() {
+        return Policy::IncrementIfNonZero(strong);
+    }
+
+    void IncreaseWeak() {
+        Policy::Increment(weak);
+    }
+
+    void DecreaseWeak() {
+        if (Policy::Decrement(weak)) {
             OnZeroWeak();
         }
     }
 
-    virtual void OnZeroWeak() = 0;
-    virtual void OnZeroStrong() = 0;
-    virtual ~ControlBlockBase() = default;
+    void OnZeroStrong() {
+        destroy(this, Phase::kZeroStrong);
+    }
+    void OnZeroWeak() {
+        destroy(this, Phase::kZeroWeak);
+    }
+};
+
+
+// Lock-free multi-producer stack of control blocks awaiting destruction.
+// One queue per policy instantiation; blocks link through deferred_next.
+template <class Policy>
+class DeferredQueue {
+public:
+    static DeferredQueue& Instance() {
+        static DeferredQueue queue;
+        return queue;
+    }
+
+    void Push(ControlBlockBase<Policy>* cb) {
+        cb->deferred_next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(cb->deferred_next, cb, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    // Runs the pending destructions; loops because destroying an object can
+    // enqueue more blocks (cascades stay iterative, not recursive). Returns
+    // the number of blocks reclaimed.
+    size_t Drain() {
+        size_t reclaimed = 0;
+        while (ControlBlockBase<Policy>* cb = head_.exchange(nullptr, std::memory_order_acquire)) {
+            while (cb) {
+                ControlBlockBase<Policy>* next = cb->deferred_next;
+                cb->OnZeroStrong();
+                cb->DecreaseWeak();
+                ++reclaimed;
+                cb = next;
+            }
+        }
+        return reclaimed;
+    }
+
+private:
+    std::atomic<ControlBlockBase<Policy>*> head_{nullptr};
 };
 
+// Explicit reclamation tick; call from a background thread or between
+// requests. A thread with deferred reclaim enabled must not rely on someone
+// else draining before shutdown.
+template <class Policy = MultiThreaded>
+size_t DrainDeferred() {
+    return DeferredQueue<Policy>::Instance().Drain();
+}
+
+
+template <class T, class Policy>
+struct ControlBlockMakeShared : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
 
-template <class T> 
-struct ControlBlockMakeShared : public ControlBlockBase {
     //alignas(T) char holder[sizeof(T)];
     std::aligned_storage_t<sizeof(T), alignof(T)> holder;
 
     template<class... Args>
-    ControlBlockMakeShared(Args&&... args) : ControlBlockBase(1, 1) {
+    ControlBlockMakeShared(Args&&... args) : Base(1, 1, &Destroy) {
+        PointerStats::OnControlBlockAlloc<T>();
         // reinterpret_cast<T*>(&holder)->T::T(args...);
         ::new(&holder) T(std::forward<Args>(args)...);
     }
 
-    void OnZeroStrong() override {
-        std::destroy_at(std::launder(reinterpret_cast<T*>(&holder)));
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockMakeShared*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            std::destroy_at(std::launder(reinterpret_cast<T*>(&self->holder)));
+        } else {
+            delete self;
+        }
+    }
+
+    // The holder drags the whole block up to alignof(T), which plain new
+    // does not honor past the default; route both directions explicitly.
+    static void* operator new(size_t size) {
+        return AllocateBlockStorage(size, alignof(ControlBlockMakeShared));
+    }
+    static void operator delete(void* p) {
+        DeallocateBlockStorage(p, alignof(ControlBlockMakeShared));
+    }
+};
+
+
+// Like ControlBlockMakeShared, but block and object storage both live inside
+// a caller-supplied allocator (e.g. an arena), and deallocation is routed
+// back through it. The allocator is moved out before the block dies.
+template <class T, class Alloc, class Policy>
+struct ControlBlockAlloc : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> holder;
+    Alloc alloc;
+
+    template <class... Args>
+    ControlBlockAlloc(const Alloc& a, Args&&... args) : Base(1, 1, &Destroy), alloc(a) {
+        PointerStats::OnControlBlockAlloc<T>();
+        ::new(&holder) T(std::forward<Args>(args)...);
+    }
+
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockAlloc*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            std::destroy_at(std::launder(reinterpret_cast<T*>(&self->holder)));
+        } else {
+            using BlockAlloc =
+                typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAlloc>;
+            BlockAlloc block_alloc(std::move(self->alloc));
+            self->~ControlBlockAlloc();
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, self, 1);
+        }
+    }
+};
+
+
+// Thread-local freelist of fixed-size chunks. Control blocks of one
+// instantiation are identical small objects, so recycling them here keeps the
+// raw-pointer-adoption path off the general-purpose allocator in steady
+// state. Blocks freed on another thread simply land on that thread's list.
+template <size_t ChunkSize>
+class ControlBlockSlab {
+public:
+    static void* Allocate() {
+        FreeList& list = GetFreeList();
+        if (!list.head) {
+            return ::operator new(ChunkSize);
+        }
+        Node* node = list.head;
+        list.head = node->next;
+        --list.size;
+        return node;
     }
 
-    void OnZeroWeak() override {
-        delete this;
+    static void Deallocate(void* p) {
+        FreeList& list = GetFreeList();
+        if (list.size >= kMaxCached) {
+            ::operator delete(p);
+            return;
+        }
+        Node* node = static_cast<Node*>(p);
+        node->next = list.head;
+        list.head = node;
+        ++list.size;
     }
 
-    ~ControlBlockMakeShared() override = default;
+private:
+    struct Node {
+        Node* next;
+    };
+    static_assert(ChunkSize >= sizeof(Node));
+
+    struct FreeList {
+        Node* head = nullptr;
+        size_t size = 0;
+
+        ~FreeList() {
+            while (head) {
+                Node* node = head;
+                head = node->next;
+                ::operator delete(node);
+            }
+        }
+    };
+
+    // Bounds per-thread cached memory at kMaxCached * ChunkSize.
+    static constexpr size_t kMaxCached = 1024;
+
+    static FreeList& GetFreeList() {
+        static thread_local FreeList list;
+        return list;
+    }
 };
 
 
-template <class T>
-struct ControlBlockPtr : public ControlBlockBase {
+template <class T, class Policy>
+struct ControlBlockPtr : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
     T* ptr;
 
-    ControlBlockPtr() : ControlBlockBase(1, 1) {
+    ControlBlockPtr() : Base(1, 1, &Destroy) {
+        PointerStats::OnControlBlockAlloc<T>();
         ptr = nullptr;
     }
 
-    ControlBlockPtr(T* p) : ControlBlockBase(1, 1) {
+    ControlBlockPtr(T* p) : Base(1, 1, &Destroy) {
+        PointerStats::OnControlBlockAlloc<T>();
+        ptr = p;
+    }
+
+    // Slab-backed: adopting a raw pointer never hits malloc in steady state.
+    static void* operator new(size_t);
+    static void operator delete(void*);
+
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockPtr*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            delete self->ptr;
+        } else {
+            delete self;
+        }
+    }
+};
+
+// Deleter sibling of ControlBlockPtr: the zero-strong action invokes a
+// user-supplied callable instead of `delete ptr`, so "destruction" can be a
+// freelist push or an arena release. Sized per deleter type, so it uses the
+// default allocator rather than the slab.
+template <class T, class D, class Policy>
+struct ControlBlockPtrDeleter : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
+    T* ptr;
+    D deleter;
+
+    ControlBlockPtrDeleter(T* p, D d) : Base(1, 1, &Destroy), ptr(p), deleter(std::move(d)) {
+        PointerStats::OnControlBlockAlloc<T>();
+    }
+
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockPtrDeleter*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            self->deleter(self->ptr);
+        } else {
+            delete self;
+        }
+    }
+};
+
+// Array sibling of ControlBlockPtr: adopts a `new T[]` pointer and releases
+// it with delete[].
+template <class T, class Policy>
+struct ControlBlockArrayPtr : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
+    T* ptr;
+
+    ControlBlockArrayPtr(T* p) : Base(1, 1, &Destroy) {
+        PointerStats::OnControlBlockAlloc<T>();
         ptr = p;
     }
 
-    void OnZeroStrong() override {
-        delete ptr;
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockArrayPtr*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            delete[] self->ptr;
+        } else {
+            delete self;
+        }
+    }
+};
+
+
+// Header and element storage share one allocation, the way
+// ControlBlockMakeShared::holder does for single objects: the elements start
+// at the first alignof(T) boundary past the header.
+template <class T, class Policy>
+struct ControlBlockArray : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
+    // The backing allocation must start aligned for T so the elements land
+    // aligned after the rounded-up header.
+    static constexpr size_t kAlignment =
+        alignof(T) > alignof(ControlBlockBase<Policy>) ? alignof(T)
+                                                       : alignof(ControlBlockBase<Policy>);
+
+    size_t count;
+
+    explicit ControlBlockArray(size_t n) : Base(1, 1, &Destroy), count(n) {
+        PointerStats::OnControlBlockAlloc<T>();
+        T* elems = Elements();
+        size_t built = 0;
+        try {
+            for (; built < n; ++built) {
+                ::new(elems + built) T();
+            }
+        } catch (...) {
+            while (built > 0) {
+                std::destroy_at(elems + --built);
+            }
+            throw;
+        }
+    }
+
+    static size_t HeaderSize() {
+        return (sizeof(ControlBlockArray) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    T* Elements() {
+        return std::launder(reinterpret_cast<T*>(reinterpret_cast<char*>(this) + HeaderSize()));
+    }
+
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockArray*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            T* elems = self->Elements();
+            for (size_t i = self->count; i > 0; --i) {
+                std::destroy_at(elems + i - 1);
+            }
+        } else {
+            self->~ControlBlockArray();
+            DeallocateBlockStorage(self, kAlignment);
+        }
+    }
+};
+
+
+// A burst of MakeShared-style blocks carved out of one allocation: the
+// header is followed by n ControlBlockBatch slots. Every slot lives and dies
+// through the usual two-phase thunk independently of its neighbours; the
+// backing memory goes back to the allocator when the last slot drains its
+// weak count, wherever and whenever that happens.
+struct BatchHeader {
+    std::atomic<size_t> remaining;
+
+    explicit BatchHeader(size_t n) : remaining(n) {
+    }
+};
+
+template <class T, class Policy>
+struct ControlBlockBatch : public ControlBlockBase<Policy> {
+    using Base = ControlBlockBase<Policy>;
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> holder;
+    BatchHeader* batch;
+
+    template <class... Args>
+    ControlBlockBatch(BatchHeader* b, Args&&... args) : Base(1, 1, &Destroy), batch(b) {
+        PointerStats::OnControlBlockAlloc<T>();
+        ::new(&holder) T(std::forward<Args>(args)...);
     }
-    void OnZeroWeak() override {
-        delete this;
+
+    static void Destroy(Base* base, typename Base::Phase phase) {
+        auto* self = static_cast<ControlBlockBatch*>(base);
+        if (phase == Base::Phase::kZeroStrong) {
+            std::destroy_at(std::launder(reinterpret_cast<T*>(&self->holder)));
+        } else {
+            ReleaseSlot(self->batch);
+        }
     }
 
-    ~ControlBlockPtr() override = default;
+    // Slots have no members needing destruction; the count in the header is
+    // what keeps the shared allocation alive.
+    static void ReleaseSlot(BatchHeader* batch) {
+        if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            DeallocateBlockStorage(batch, alignof(ControlBlockBatch));
+        }
+    }
 };
 
 
+template <class T, class Policy>
+void* ControlBlockPtr<T, Policy>::operator new(size_t) {
+    return ControlBlockSlab<sizeof(ControlBlockPtr)>::Allocate();
+}
+
+template <class T, class Policy>
+void ControlBlockPtr<T, Policy>::operator delete(void* p) {
+    ControlBlockSlab<sizeof(ControlBlockPtr)>::Deallocate(p);
+}
+
+
+
+
+
+// Derive T from EnableIntrusiveCount<T> and SharedPtr(T*) adopts the control
+// block embedded in the object itself: zero extra allocation and the counts
+// share a cache line with the data. Because block and object share storage,
+// the object is released only when the weak count drains too - with no
+// WeakPtrs around that is immediately after the last strong owner, while an
+// outstanding WeakPtr keeps the (already unreachable) object in memory until
+// it drops. Adopted objects must be heap-allocated with plain new.
+template <typename T, typename Policy>
+class EnableIntrusiveCount : public EnableIntrusiveCountBase {
+public:
+    EnableIntrusiveCount() = default;
+
+    // Copying an object must not copy its reference counts.
+    EnableIntrusiveCount(const EnableIntrusiveCount&) = delete;
+    EnableIntrusiveCount& operator=(const EnableIntrusiveCount&) = delete;
+
+private:
+    template <class A, class P>
+    friend class SharedPtr;
+
+    struct EmbeddedBlock : ControlBlockBase<Policy> {
+        using Base = ControlBlockBase<Policy>;
+
+        EnableIntrusiveCount* owner;
+
+        explicit EmbeddedBlock(EnableIntrusiveCount* o) : Base(0, 1, &Destroy), owner(o) {
+        }
+
+        static void Destroy(Base* base, typename Base::Phase phase) {
+            // kZeroStrong is a no-op: the destructor must wait until the
+            // block (living inside the object) is no longer observable.
+            if (phase == Base::Phase::kZeroWeak) {
+                delete static_cast<T*>(static_cast<EmbeddedBlock*>(base)->owner);
+            }
+        }
+    };
+
+    ControlBlockBase<Policy>* IntrusiveBlock() {
+        return &block_;
+    }
 
+    EmbeddedBlock block_{this};
+};
 
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
-template <typename T>
-class SharedPtr {
+template <typename T, typename Policy>
+class SharedPtr : private SharedHandleTracker {
 private:
-    ControlBlockBase* cb_;
+    ControlBlockBase<Policy>* cb_;
     T* ptr_;
- 
+
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
-    template <class A>
+    template <class A, class P>
     friend class SharedPtr;
 
+    // The empty state is null cb_/ptr_: constructing, moving and destroying an
+    // empty SharedPtr never touches the allocator.
     SharedPtr() {
-        cb_ = new ControlBlockPtr<T>();
+        cb_ = nullptr;
         ptr_ = nullptr;
     }
 
-    SharedPtr(std::nullptr_t) { 
+    SharedPtr(std::nullptr_t) {
         cb_ = nullptr;
         ptr_ = nullptr;
     }
-    
-    
+
+
     template <class X>
     explicit SharedPtr(X* ptr) {
-        cb_ = new ControlBlockPtr<T>(ptr);
+        if constexpr (std::is_convertible_v<X*, EnableIntrusiveCountBase*>) {
+            // Intrusive fast path: reuse the block embedded in the object.
+            // A null adoptee has no embedded block; stay empty, like the
+            // generic branch accepting a null pointer.
+            if (!ptr) {
+                cb_ = nullptr;
+                ptr_ = nullptr;
+                return;
+            }
+            cb_ = ptr->IntrusiveBlock();
+            cb_->IncreaseStrong();
+        } else {
+            cb_ = new ControlBlockPtr<T, Policy>(ptr);
+        }
+        ptr_ = ptr;
+        if constexpr (std::is_convertible_v<X*, EnableSharedFromThisBase*>) {
+            InitWeakThis(ptr);
+        }
+    }
+
+    // Adopts `ptr` with a custom deleter: dropping the last strong reference
+    // runs `d(ptr)` instead of `delete ptr`, so the object can go back to a
+    // pool or an mmap region. The intrusive fast path is deliberately skipped
+    // here — an embedded block would ignore the deleter.
+    // Constrained so the (control block, pointer) constructor below keeps
+    // winning overload resolution for derived block pointers.
+    template <class X, class D, class = std::enable_if_t<std::is_invocable_v<D&, X*>>>
+    SharedPtr(X* ptr, D d) {
+        cb_ = new ControlBlockPtrDeleter<T, D, Policy>(ptr, std::move(d));
         ptr_ = ptr;
+        if constexpr (std::is_convertible_v<X*, EnableSharedFromThisBase*>) {
+            InitWeakThis(ptr);
+        }
+    }
+
+    // Non-template overloads: the converting constructors below do not
+    // suppress the implicitly generated special members.
+    SharedPtr(const SharedPtr& other) : SharedHandleTracker(other) {
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
+        ptr_ = other.ptr_;
+    }
+
+    SharedPtr(SharedPtr&& other) {
+        cb_ = other.cb_;
+        other.cb_ = nullptr;
+        ptr_ = other.ptr_;
+        other.ptr_ = nullptr;
     }
 
     template <class X>
-    SharedPtr(const SharedPtr<X>& other) {
+    SharedPtr(const SharedPtr<X, Policy>& other) {
         cb_ = other.cb_;
-        cb_->IncreaseStrong();
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
         ptr_ = other.ptr_;
     }
 
     template <class X>
-    SharedPtr(SharedPtr<X>&& other) {
+    SharedPtr(SharedPtr<X, Policy>&& other) {
         cb_ = other.cb_;
         other.cb_ = nullptr;
         ptr_ = other.ptr_;
@@ -130,41 +916,54 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
+    SharedPtr(const SharedPtr<Y, Policy>& other, T* ptr) {
         cb_ = other.cb_;
-        cb_->IncreaseStrong();
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
         ptr_ = ptr;
     }
 
 
-    
-/*
+
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other);
+    // Throws BadWeakPtr when the object already expired. Defined below WeakPtr.
+    explicit SharedPtr(const WeakPtr<T, Policy>& other);
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
-*/
+
+    SharedPtr& operator=(const SharedPtr& other) {
+        return operator=<T>(other);
+    }
+    SharedPtr& operator=(SharedPtr&& other) {
+        return operator=<T>(std::move(other));
+    }
     template <class X>
-    SharedPtr& operator=(const SharedPtr<X>& other) {
-        if (other == *this) {
+    SharedPtr& operator=(const SharedPtr<X, Policy>& other) {
+        if ((void*)&other == (void*)this) {
             return *this;
         }
-        cb_->DecreaseStrong();
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
         cb_ = other.cb_;
-        cb_->IncreaseStrong();
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
         ptr_ = other.ptr_;
         return *this;
     }
-    template <class X>    
-    SharedPtr& operator=(SharedPtr<X>&& other) {
-        if (other == * this) {
+    template <class X>
+    SharedPtr& operator=(SharedPtr<X, Policy>&& other) {
+        if ((void*)&other == (void*)this) {
             return *this;
         }
-        cb_->DecreaseStrong();
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
         cb_ = other.cb_;
-        cb_->IncreaseStrong();
         ptr_ = other.ptr_;
         other.ptr_ = nullptr;
         other.cb_ = nullptr;
@@ -175,9 +974,8 @@ public:
     // Destructor
 
     ~SharedPtr() {
-        cb_->DecreaseStrong();
-        if (ptr_) {
-            delete ptr_;
+        if (cb_) {
+            cb_->DecreaseStrong();
         }
     }
 
@@ -189,23 +987,33 @@ public:
             cb_->DecreaseStrong();
         }
         cb_ = nullptr;
-        if (ptr_) {
-            delete ptr_;
-        }
         ptr_ = nullptr;
     }
     void Reset(T* ptr) {
         if (cb_) {
             cb_->DecreaseStrong();
         }
-        cb_ = new ControlBlockPtr(ptr);
-        if (ptr_) {
-            delete ptr_;
+        if constexpr (std::is_convertible_v<T*, EnableIntrusiveCountBase*>) {
+            // No embedded block to borrow from a null adoptee.
+            if (!ptr) {
+                cb_ = nullptr;
+                ptr_ = nullptr;
+                return;
+            }
+            cb_ = ptr->IntrusiveBlock();
+            cb_->IncreaseStrong();
+        } else {
+            cb_ = new ControlBlockPtr<T, Policy>(ptr);
         }
         ptr_ = ptr;
+        // Like the adopting constructors: SharedFromThis() must work after a
+        // Reset(raw) just as it does after SharedPtr(raw).
+        if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
+            InitWeakThis(ptr);
+        }
     }
     template <class X>
-    void Swap(SharedPtr<X>& other) {
+    void Swap(SharedPtr<X, Policy>& other) {
         std::swap(cb_, other.cb_);
         std::swap(ptr_, other.ptr_);
     }
@@ -223,46 +1031,519 @@ public:
         return Get();
     }
     size_t UseCount() const {
-        return cb_->UseCount();
+        return cb_ ? cb_->UseCount() : 0;
     }
     explicit operator bool() const {
         return ptr_ != nullptr;
-    }    
+    }
 
-    template <typename V, typename U>
-    friend inline bool operator==(const SharedPtr<V>& left, const SharedPtr<U>& right);
-    template <class V, class... Args>
-    friend SharedPtr<V> MakeShared(Args&&... args);
+    template <typename V, typename U, typename P>
+    friend inline bool operator==(const SharedPtr<V, P>& left, const SharedPtr<U, P>& right);
+    template <class V, class P, class... Args>
+    friend SharedPtr<V, P> MakeShared(Args&&... args);
+    template <class V, class P, class Alloc, class... Args>
+    friend SharedPtr<V, P> AllocateShared(const Alloc& alloc, Args&&... args);
+    template <class V, class P, class Gen>
+    friend std::vector<SharedPtr<V, P>> MakeSharedBatch(size_t n, Gen&& gen);
+    template <class A, class P>
+    friend class WeakPtr;
+    template <class A, class X, class P>
+    friend SharedPtr<A, P> StaticPointerCast(SharedPtr<X, P>&& sp);
+    template <class A, class X, class P>
+    friend SharedPtr<A, P> DynamicPointerCast(SharedPtr<X, P>&& sp);
+    template <class A, class X, class P>
+    friend SharedPtr<A, P> ConstPointerCast(SharedPtr<X, P>&& sp);
 
-    SharedPtr(ControlBlockBase* cb, T* ptr) {
+    SharedPtr(ControlBlockBase<Policy>* cb, T* ptr) {
         cb_ = cb;
         ptr_ = ptr;
     }
+
+private:
+    // Points the object's embedded weak_this_ at our control block, so
+    // SharedFromThis() reuses it instead of allocating a second one.
+    template <class X>
+    void InitWeakThis(X* ptr) {
+        using W = std::remove_reference_t<decltype(ptr->weak_this_)>;
+        ptr->weak_this_ = W(cb_, ptr);
+    }
 };
 
-template <class V, class... Args>
-SharedPtr<V> MakeShared(Args&&... args) {
-    ControlBlockBase* cb = new ControlBlockMakeShared<V>(std::forward<Args>(args)...);
-    V* ptr = reinterpret_cast<V*>(&dynamic_cast<ControlBlockMakeShared<V>*>(cb)->holder);
-    return SharedPtr<V>(cb, ptr);
+// Array specialization: owns `count` elements instead of one object and
+// exposes operator[] in place of dereference.
+template <typename T, typename Policy>
+class SharedPtr<T[], Policy> : private SharedHandleTracker {
+private:
+    ControlBlockBase<Policy>* cb_;
+    T* ptr_;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtr() {
+        cb_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+    SharedPtr(std::nullptr_t) {
+        cb_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+    // Adopts a `new T[n]` pointer; released with delete[].
+    explicit SharedPtr(T* ptr) {
+        cb_ = new ControlBlockArrayPtr<T, Policy>(ptr);
+        ptr_ = ptr;
+    }
+
+    SharedPtr(const SharedPtr& other) : SharedHandleTracker(other) {
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
+        ptr_ = other.ptr_;
+    }
+
+    SharedPtr(SharedPtr&& other) {
+        cb_ = other.cb_;
+        other.cb_ = nullptr;
+        ptr_ = other.ptr_;
+        other.ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtr& operator=(const SharedPtr& other) {
+        if (&other == this) {
+            return *this;
+        }
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseStrong();
+        }
+        ptr_ = other.ptr_;
+        return *this;
+    }
+
+    SharedPtr& operator=(SharedPtr&& other) {
+        if (&other == this) {
+            return *this;
+        }
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
+        cb_ = other.cb_;
+        ptr_ = other.ptr_;
+        other.cb_ = nullptr;
+        other.ptr_ = nullptr;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtr() {
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
+        cb_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+    void Reset(T* ptr) {
+        if (cb_) {
+            cb_->DecreaseStrong();
+        }
+        cb_ = new ControlBlockArrayPtr<T, Policy>(ptr);
+        ptr_ = ptr;
+    }
+
+    void Swap(SharedPtr& other) {
+        std::swap(cb_, other.cb_);
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator[](size_t i) const {
+        return ptr_[i];
+    }
+    size_t UseCount() const {
+        return cb_ ? cb_->UseCount() : 0;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    template <typename V, typename P>
+    friend SharedPtr<V[], P> MakeSharedArray(size_t n);
+
+    SharedPtr(ControlBlockBase<Policy>* cb, T* ptr) {
+        cb_ = cb;
+        ptr_ = ptr;
+    }
+};
+
+// One allocation holds the control block and all n value-initialized
+// elements, cache-line adjacent to the header.
+template <typename V, typename P = MultiThreaded>
+SharedPtr<V[], P> MakeSharedArray(size_t n) {
+    using Block = ControlBlockArray<V, P>;
+    void* mem = AllocateBlockStorage(Block::HeaderSize() + n * sizeof(V), Block::kAlignment);
+    Block* cb;
+    try {
+        cb = ::new(mem) Block(n);
+    } catch (...) {
+        DeallocateBlockStorage(mem, Block::kAlignment);
+        throw;
+    }
+    return SharedPtr<V[], P>(cb, cb->Elements());
+}
+
+template <class V, class P = MultiThreaded, class... Args>
+SharedPtr<V, P> MakeShared(Args&&... args) {
+    auto* cb = new ControlBlockMakeShared<V, P>(std::forward<Args>(args)...);
+    V* ptr = reinterpret_cast<V*>(&cb->holder);
+    SharedPtr<V, P> sp(cb, ptr);
+    if constexpr (std::is_convertible_v<V*, EnableSharedFromThisBase*>) {
+        sp.InitWeakThis(ptr);
+    }
+    return sp;
+}
+
+// Burst construction: carves n control-block+object slots out of one
+// contiguous allocation, so creating a thousand shared nodes costs one
+// allocator round trip instead of a thousand. `gen(i)` produces the value
+// for the i-th slot. Each SharedPtr is independent; the backing memory is
+// freed when the last slot dies.
+template <class V, class P = MultiThreaded, class Gen>
+std::vector<SharedPtr<V, P>> MakeSharedBatch(size_t n, Gen&& gen) {
+    using Block = ControlBlockBatch<V, P>;
+    std::vector<SharedPtr<V, P>> out;
+    if (n == 0) {
+        return out;
+    }
+    out.reserve(n);
+    constexpr size_t kHeaderSize =
+        (sizeof(BatchHeader) + alignof(Block) - 1) / alignof(Block) * alignof(Block);
+    void* mem = AllocateBlockStorage(kHeaderSize + n * sizeof(Block), alignof(Block));
+    auto* batch = ::new(mem) BatchHeader(n);
+    Block* slots = reinterpret_cast<Block*>(static_cast<char*>(mem) + kHeaderSize);
+    size_t built = 0;
+    try {
+        for (; built < n; ++built) {
+            Block* cb = ::new(slots + built) Block(batch, gen(built));
+            V* ptr = reinterpret_cast<V*>(&cb->holder);
+            out.emplace_back(SharedPtr<V, P>(cb, ptr));
+            if constexpr (std::is_convertible_v<V*, EnableSharedFromThisBase*>) {
+                out.back().InitWeakThis(ptr);
+            }
+        }
+    } catch (...) {
+        // Slots never built give their share of the header count back here;
+        // the built ones are released by `out` unwinding like any SharedPtr.
+        if (batch->remaining.fetch_sub(n - built, std::memory_order_acq_rel) == n - built) {
+            DeallocateBlockStorage(mem, alignof(Block));
+        }
+        throw;
+    }
+    return out;
+}
+
+template <class V, class P = MultiThreaded>
+std::vector<SharedPtr<V, P>> MakeSharedBatch(size_t n) {
+    return MakeSharedBatch<V, P>(n, [](size_t) { return V(); });
+}
+
+// One allocation from `alloc` holds the control block and the object.
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/allocate_shared
+template <class V, class P = MultiThreaded, class Alloc, class... Args>
+SharedPtr<V, P> AllocateShared(const Alloc& alloc, Args&&... args) {
+    using Block = ControlBlockAlloc<V, Alloc, P>;
+    using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    BlockAlloc block_alloc(alloc);
+    Block* cb = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+    try {
+        ::new(cb) Block(alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        std::allocator_traits<BlockAlloc>::deallocate(block_alloc, cb, 1);
+        throw;
+    }
+    V* ptr = reinterpret_cast<V*>(&cb->holder);
+    SharedPtr<V, P> sp(cb, ptr);
+    if constexpr (std::is_convertible_v<V*, EnableSharedFromThisBase*>) {
+        sp.InitWeakThis(ptr);
+    }
+    return sp;
 }
- 
-template <typename V, typename U>
-inline bool operator==(const SharedPtr<V>& left, const SharedPtr<U>& right) {
+
+template <typename V, typename U, typename P>
+inline bool operator==(const SharedPtr<V, P>& left, const SharedPtr<U, P>& right) {
     return (void*)left.ptr_ == (void*)right.ptr_;
 }
 
-/*
-// Look for usage examples in tests
-template <typename T>
-class EnableSharedFromThis {
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pointer casts
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+//
+// The lvalue overloads share ownership through the aliasing constructor; the
+// rvalue overloads steal cb_/ptr_ outright, so a cast in a hot dispatch path
+// is two pointer moves and zero counter operations.
+
+template <class T, class U, class P>
+SharedPtr<T, P> StaticPointerCast(const SharedPtr<U, P>& sp) {
+    return SharedPtr<T, P>(sp, static_cast<T*>(sp.Get()));
+}
+
+template <class T, class U, class P>
+SharedPtr<T, P> StaticPointerCast(SharedPtr<U, P>&& sp) {
+    SharedPtr<T, P> result(sp.cb_, static_cast<T*>(sp.ptr_));
+    sp.cb_ = nullptr;
+    sp.ptr_ = nullptr;
+    return result;
+}
+
+template <class T, class U, class P>
+SharedPtr<T, P> DynamicPointerCast(const SharedPtr<U, P>& sp) {
+    if (T* p = dynamic_cast<T*>(sp.Get())) {
+        return SharedPtr<T, P>(sp, p);
+    }
+    return SharedPtr<T, P>();
+}
+
+template <class T, class U, class P>
+SharedPtr<T, P> DynamicPointerCast(SharedPtr<U, P>&& sp) {
+    T* p = dynamic_cast<T*>(sp.ptr_);
+    if (!p) {
+        return SharedPtr<T, P>();
+    }
+    SharedPtr<T, P> result(sp.cb_, p);
+    sp.cb_ = nullptr;
+    sp.ptr_ = nullptr;
+    return result;
+}
+
+template <class T, class U, class P>
+SharedPtr<T, P> ConstPointerCast(const SharedPtr<U, P>& sp) {
+    return SharedPtr<T, P>(sp, const_cast<T*>(sp.Get()));
+}
+
+template <class T, class U, class P>
+SharedPtr<T, P> ConstPointerCast(SharedPtr<U, P>&& sp) {
+    SharedPtr<T, P> result(sp.cb_, const_cast<T*>(sp.ptr_));
+    sp.cb_ = nullptr;
+    sp.ptr_ = nullptr;
+    return result;
+}
+
+// https://en.cppreference.com/w/cpp/memory/weak_ptr
+template <typename T, typename Policy>
+class WeakPtr {
+private:
+    ControlBlockBase<Policy>* cb_;
+    T* ptr_;
+
+    template <class A, class P>
+    friend class SharedPtr;
+    template <class A, class P>
+    friend class WeakPtr;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    WeakPtr() {
+        cb_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+private:
+    // Used by SharedPtr::InitWeakThis to seed EnableSharedFromThis.
+    WeakPtr(ControlBlockBase<Policy>* cb, T* ptr) : cb_(cb), ptr_(ptr) {
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+    }
+
 public:
-    SharedPtr<T> SharedFromThis();
-    SharedPtr<const T> SharedFromThis() const;
 
-    WeakPtr<T> WeakFromThis() noexcept;
-    WeakPtr<const T> WeakFromThis() const noexcept;
+    WeakPtr(const WeakPtr& other) {
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+        ptr_ = other.ptr_;
+    }
+
+    WeakPtr(WeakPtr&& other) {
+        cb_ = other.cb_;
+        other.cb_ = nullptr;
+        ptr_ = other.ptr_;
+        other.ptr_ = nullptr;
+    }
+
+    template <class X>
+    WeakPtr(const WeakPtr<X, Policy>& other) {
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+        ptr_ = other.ptr_;
+    }
+
+    template <class X>
+    WeakPtr(const SharedPtr<X, Policy>& other) {
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+        ptr_ = other.ptr_;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    WeakPtr& operator=(const WeakPtr& other) {
+        if (&other == this) {
+            return *this;
+        }
+        if (cb_) {
+            cb_->DecreaseWeak();
+        }
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+        ptr_ = other.ptr_;
+        return *this;
+    }
+
+    WeakPtr& operator=(WeakPtr&& other) {
+        if (&other == this) {
+            return *this;
+        }
+        if (cb_) {
+            cb_->DecreaseWeak();
+        }
+        cb_ = other.cb_;
+        ptr_ = other.ptr_;
+        other.cb_ = nullptr;
+        other.ptr_ = nullptr;
+        return *this;
+    }
+
+    template <class X>
+    WeakPtr& operator=(const SharedPtr<X, Policy>& other) {
+        if (cb_) {
+            cb_->DecreaseWeak();
+        }
+        cb_ = other.cb_;
+        if (cb_) {
+            cb_->IncreaseWeak();
+        }
+        ptr_ = other.ptr_;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~WeakPtr() {
+        if (cb_) {
+            cb_->DecreaseWeak();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (cb_) {
+            cb_->DecreaseWeak();
+        }
+        cb_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+    void Swap(WeakPtr& other) {
+        std::swap(cb_, other.cb_);
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        return cb_ ? cb_->UseCount() : 0;
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    // Lock-free promotion: succeeds only if the strong count is still
+    // non-zero, via IncrementIfNonZero's CAS loop. Returns an empty
+    // SharedPtr when the object already died.
+    SharedPtr<T, Policy> Lock() const {
+        if (cb_ && cb_->TryIncreaseStrong()) {
+            return SharedPtr<T, Policy>(cb_, ptr_);
+        }
+        return SharedPtr<T, Policy>();
+    }
+};
+
+template <typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(const WeakPtr<T, Policy>& other) {
+    if (!other.cb_ || !other.cb_->TryIncreaseStrong()) {
+        throw BadWeakPtr();
+    }
+    cb_ = other.cb_;
+    ptr_ = other.ptr_;
+}
+
+// Derive T from EnableSharedFromThis<T> to hand out SharedPtr<T> from inside
+// member functions. The first SharedPtr that takes ownership seeds weak_this_
+// with its own control block, so SharedFromThis() never allocates another one.
+template <typename T, typename Policy>
+class EnableSharedFromThis : public EnableSharedFromThisBase {
+public:
+    SharedPtr<T, Policy> SharedFromThis() {
+        return SharedPtr<T, Policy>(weak_this_);
+    }
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return SharedPtr<const T, Policy>(WeakPtr<const T, Policy>(weak_this_));
+    }
+
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
+        return weak_this_;
+    }
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
+        return WeakPtr<const T, Policy>(weak_this_);
+    }
+
+private:
+    template <class A, class P>
+    friend class SharedPtr;
+
+    WeakPtr<T, Policy> weak_this_;
 };
 
-*/
-// std::make_shared<int>(42);
\ No newline at end of file
+// std::make_shared<int>(42);
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Epoch-based reclamation for read-mostly structures. SharedPtr copies cost
+// an atomic RMW on the control block, which turns into cache-line ping-pong
+// when many reader cores snapshot the same object. Here a reader instead pins
+// the current epoch — a couple of uncontended atomics on its own TLS slot, no
+// shared-line RMW — and takes a raw pointer. A writer publishes a replacement version, advances the
+// global epoch and parks the old version's SharedPtr on a retire list; the
+// deferred DecreaseStrong (and with it the control block's usual zero-strong
+// machinery) runs once every pinned reader has moved past the retire epoch.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Global epoch plus one slot per reader thread. Slots are allocated once,
+// never freed, and recycled across threads, so MinActive() can walk the chain
+// without locking.
+class EpochRegistry {
+public:
+    struct Slot {
+        // 0 = not pinned, otherwise the epoch this reader entered at.
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{false};
+        // Nested pins share one announcement. Only the owning thread pins,
+        // but a SnapshotPtr moved to another thread unpins from there, so
+        // the count is atomic.
+        std::atomic<int> depth{0};
+        // Set when the owning thread exits with pins still outstanding; the
+        // final Unpin() hands the slot back in its stead.
+        std::atomic<bool> orphaned{false};
+        Slot* next = nullptr;
+    };
+
+    static EpochRegistry& Instance() {
+        static EpochRegistry registry;
+        return registry;
+    }
+
+    // The seq_cst store/re-check loop closes the classic race where a writer
+    // advances and scans between our epoch read and the slot announcement:
+    // either the scan sees our announcement, or we see the new epoch and
+    // re-announce before touching any data. Returns the announced slot; the
+    // matching Unpin() takes it back, so a pin may be released from any
+    // thread.
+    static Slot* Pin() {
+        Slot& slot = LocalSlot();
+        if (slot.depth.fetch_add(1, std::memory_order_acq_rel) > 0) {
+            return &slot;
+        }
+        // A foreign Unpin() that just dropped the depth to zero may not have
+        // cleared the announcement yet; wait it out, or its clearing store
+        // could land on top of ours and unpin us silently.
+        while (slot.epoch.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        EpochRegistry& self = Instance();
+        uint64_t e = self.global_.load(std::memory_order_seq_cst);
+        while (true) {
+            slot.epoch.store(e, std::memory_order_seq_cst);
+            uint64_t now = self.global_.load(std::memory_order_seq_cst);
+            if (now == e) {
+                return &slot;
+            }
+            e = now;
+        }
+    }
+
+    static void Unpin(Slot* slot) {
+        if (slot->depth.fetch_sub(1, std::memory_order_acq_rel) > 1) {
+            return;
+        }
+        slot->epoch.store(0, std::memory_order_release);
+        // The owning thread may have exited while we held the pin; hand the
+        // slot back for it (see ~Handle).
+        if (slot->orphaned.exchange(false, std::memory_order_acq_rel)) {
+            slot->in_use.store(false, std::memory_order_release);
+        }
+    }
+
+    // Bumps the global epoch; returns the epoch that just ended.
+    uint64_t Advance() {
+        return global_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // Smallest epoch any reader is currently pinned at; ~0 when none are.
+    uint64_t MinActive() const {
+        uint64_t min = ~uint64_t{0};
+        for (Slot* s = slots_.load(std::memory_order_acquire); s; s = s->next) {
+            uint64_t e = s->epoch.load(std::memory_order_seq_cst);
+            if (e != 0 && e < min) {
+                min = e;
+            }
+        }
+        return min;
+    }
+
+private:
+    static Slot& LocalSlot() {
+        // Registered on first use, handed back for reuse at thread exit.
+        struct Handle {
+            Slot* slot;
+
+            Handle() : slot(Instance().AcquireSlot()) {
+            }
+            ~Handle() {
+                // A SnapshotPtr moved to another thread may still hold a
+                // pin; if so, mark the slot and let its final Unpin() hand
+                // it back. A racing unpin can strand one slot as
+                // permanently in_use — benign, scans skip it once the epoch
+                // clears — but never recycles it under a live pin.
+                if (slot->depth.load(std::memory_order_acquire) == 0) {
+                    slot->in_use.store(false, std::memory_order_release);
+                    return;
+                }
+                slot->orphaned.store(true, std::memory_order_release);
+                if (slot->depth.load(std::memory_order_seq_cst) == 0 &&
+                    slot->orphaned.exchange(false, std::memory_order_acq_rel)) {
+                    // The last unpin finished before it could see the mark;
+                    // hand the slot back ourselves.
+                    slot->in_use.store(false, std::memory_order_release);
+                }
+            }
+        };
+        static thread_local Handle handle;
+        return *handle.slot;
+    }
+
+    Slot* AcquireSlot() {
+        for (Slot* s = slots_.load(std::memory_order_acquire); s; s = s->next) {
+            bool expected = false;
+            if (s->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return s;
+            }
+        }
+        auto* s = new Slot;
+        s->in_use.store(true, std::memory_order_relaxed);
+        s->next = slots_.load(std::memory_order_relaxed);
+        while (!slots_.compare_exchange_weak(s->next, s, std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+        }
+        return s;
+    }
+
+    // Epoch 0 means "unpinned", so the clock starts at 1.
+    std::atomic<uint64_t> global_{1};
+    std::atomic<Slot*> slots_{nullptr};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A pinned raw view of one version. Holding one keeps the pointee alive (the
+// source cannot reclaim the version while the pin predates its retirement)
+// without ever touching the control block. Move-only; it remembers the slot
+// it pinned, so moving it to another thread and dropping it there releases
+// the pin on the slot that took it, not the destroyer's.
+template <typename T>
+class SnapshotPtr {
+public:
+    SnapshotPtr() : ptr_(nullptr), slot_(nullptr) {
+    }
+
+    SnapshotPtr(SnapshotPtr&& other) : ptr_(other.ptr_), slot_(other.slot_) {
+        other.ptr_ = nullptr;
+        other.slot_ = nullptr;
+    }
+
+    SnapshotPtr& operator=(SnapshotPtr&& other) {
+        if (this != &other) {
+            Reset();
+            ptr_ = other.ptr_;
+            slot_ = other.slot_;
+            other.ptr_ = nullptr;
+            other.slot_ = nullptr;
+        }
+        return *this;
+    }
+
+    SnapshotPtr(const SnapshotPtr&) = delete;
+    SnapshotPtr& operator=(const SnapshotPtr&) = delete;
+
+    ~SnapshotPtr() {
+        Reset();
+    }
+
+    void Reset() {
+        if (slot_) {
+            EpochRegistry::Unpin(slot_);
+        }
+        ptr_ = nullptr;
+        slot_ = nullptr;
+    }
+
+    const T* Get() const {
+        return ptr_;
+    }
+    const T& operator*() const {
+        return *ptr_;
+    }
+    const T* operator->() const {
+        return ptr_;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+private:
+    template <typename, typename>
+    friend class SnapshotSource;
+
+    SnapshotPtr(const T* ptr, EpochRegistry::Slot* slot) : ptr_(ptr), slot_(slot) {
+    }
+
+    const T* ptr_;
+    EpochRegistry::Slot* slot_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Writer-side holder of the current version. Snapshot() costs a pin plus one
+// raw load; Store() swaps versions and retires the old one. Writers are
+// serialized internally (they are the rare case), and retired versions are
+// swept opportunistically on every Store() or explicitly via
+// ReclaimRetired(). All snapshots must be dropped before the source dies.
+template <typename T, typename Policy = MultiThreaded>
+class SnapshotSource {
+public:
+    SnapshotSource() = default;
+
+    explicit SnapshotSource(SharedPtr<T, Policy> initial) {
+        Store(std::move(initial));
+    }
+
+    SnapshotSource(const SnapshotSource&) = delete;
+    SnapshotSource& operator=(const SnapshotSource&) = delete;
+
+    // Readers: pin first, then load, so any version we can observe is
+    // guaranteed to outlive the pin.
+    SnapshotPtr<T> Snapshot() const {
+        EpochRegistry::Slot* slot = EpochRegistry::Pin();
+        return SnapshotPtr<T>(ptr_.load(std::memory_order_acquire), slot);
+    }
+
+    void Store(SharedPtr<T, Policy> next) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ptr_.store(next.Get(), std::memory_order_release);
+        if (current_) {
+            // Readers pinned at or before the epoch that just ended may
+            // still hold the old version.
+            retired_.push_back({std::move(current_), EpochRegistry::Instance().Advance()});
+        }
+        current_ = std::move(next);
+        ReclaimLocked();
+    }
+
+    // The writer's own strong reference to the current version.
+    SharedPtr<T, Policy> Current() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return current_;
+    }
+
+    // Drops retired versions no pinned reader can still see; returns how many
+    // were released. Dropping the SharedPtr runs the normal control-block
+    // destruction path.
+    size_t ReclaimRetired() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ReclaimLocked();
+    }
+
+    size_t NumRetired() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_.size();
+    }
+
+private:
+    struct Retired {
+        SharedPtr<T, Policy> version;
+        uint64_t epoch;
+    };
+
+    size_t ReclaimLocked() {
+        uint64_t min = EpochRegistry::Instance().MinActive();
+        size_t released = 0;
+        for (size_t i = 0; i < retired_.size();) {
+            if (retired_[i].epoch < min) {
+                retired_[i] = std::move(retired_.back());
+                retired_.pop_back();
+                ++released;
+            } else {
+                ++i;
+            }
+        }
+        return released;
+    }
+
+    mutable std::mutex mutex_;
+    std::atomic<T*> ptr_{nullptr};
+    SharedPtr<T, Policy> current_;
+    std::vector<Retired> retired_;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <exception>
+
+class BadWeakPtr : public std::exception {};
+
+struct SingleThreaded;
+struct MultiThreaded;
+struct Biased;
+
+template <typename T, typename Policy = MultiThreaded>
+class SharedPtr;
+
+template <typename T, typename Policy = MultiThreaded>
+class WeakPtr;
+
+// Tag base so SharedPtr's constructors can detect EnableSharedFromThis
+// without knowing T/Policy.
+class EnableSharedFromThisBase {};
+
+// Same idea for EnableIntrusiveCount.
+class EnableIntrusiveCountBase {};
+
+template <typename T, typename Policy = MultiThreaded>
+class EnableIntrusiveCount;
+
+template <typename T, typename Policy = MultiThreaded>
+class EnableSharedFromThis;
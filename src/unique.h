@@ -1,20 +1,63 @@
+#pragma once
+
+#include "pointer_stats.h"  // Optional instrumentation; no-ops unless enabled
+
 #include <algorithm>
 #include <cstddef>
 #include <memory>
+#include <new>
 #include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Stores the deleter via the empty-base optimization: for a stateless deleter
+// (the overwhelmingly common case) the holder contributes no storage, so
+// UniquePtr stays a single pointer wide.
+template <typename Deleter, bool = std::is_empty_v<Deleter> && !std::is_final_v<Deleter>>
+class DeleterHolder {
+public:
+    DeleterHolder() noexcept = default;
+    DeleterHolder(Deleter d) noexcept : del_(std::move(d)) {
+    }
+
+    Deleter &Del() noexcept {
+        return del_;
+    }
+    const Deleter &Del() const noexcept {
+        return del_;
+    }
+
+private:
+    Deleter del_;
+};
+
+template <typename Deleter>
+class DeleterHolder<Deleter, true> : private Deleter {
+public:
+    DeleterHolder() noexcept = default;
+    DeleterHolder(Deleter d) noexcept : Deleter(std::move(d)) {
+    }
+
+    Deleter &Del() noexcept {
+        return *this;
+    }
+    const Deleter &Del() const noexcept {
+        return *this;
+    }
+};
 
 template <typename T, typename Deleter = std::default_delete<T>>
-class UniquePtr {
+class UniquePtr : private DeleterHolder<Deleter>, private UniqueHandleTracker {
 public:
-    UniquePtr() noexcept : ptr_(nullptr), del_(Deleter()) {
+    UniquePtr() noexcept : ptr_(nullptr) {
     }
 
     template <class Y>
-    UniquePtr(Y *elem) noexcept : ptr_(elem), del_(Deleter()) {
+    UniquePtr(Y *elem) noexcept : ptr_(elem) {
     }
 
     template <class Y>
-    UniquePtr(Y *elem, Deleter d) noexcept : ptr_(elem), del_(d) {
+    UniquePtr(Y *elem, Deleter d) noexcept : DeleterHolder<Deleter>(std::move(d)), ptr_(elem) {
     }
 
     template <class Y>
@@ -23,20 +66,20 @@ public:
             return;
         }
         ptr_ = u_ptr.ptr_;
-        del_ = u_ptr.del_;
+        GetDeleter() = u_ptr.GetDeleter();
         u_ptr.ptr_ = nullptr;
     }
 
     Deleter &GetDeleter() noexcept {
-        return del_;
+        return this->Del();
     }
 
     const Deleter &GetDeleter() const noexcept {
-        return del_;
+        return this->Del();
     }
 
     UniquePtr &operator=(std::nullptr_t) noexcept {
-        del_(ptr_);
+        GetDeleter()(ptr_);
         ptr_ = nullptr;
         return *this;
     }
@@ -45,15 +88,15 @@ public:
         if (u_ptr.ptr_ == ptr_) {
             return *this;
         }
-        del_(ptr_);
+        GetDeleter()(ptr_);
         ptr_ = u_ptr.ptr_;
-        del_ = u_ptr.del_;
+        GetDeleter() = u_ptr.GetDeleter();
         u_ptr.ptr_ = nullptr;
         return *this;
     }
 
     ~UniquePtr() {
-        del_(ptr_);
+        GetDeleter()(ptr_);
     }
 
     const T &operator*() const {
@@ -73,13 +116,13 @@ public:
     void Reset(T *p = nullptr) noexcept {
         std::swap(ptr_, p);
         if (p != nullptr) {
-            del_(p);
+            GetDeleter()(p);
         }
     }
 
     void Swap(UniquePtr &other) noexcept {
         std::swap(ptr_, other.ptr_);
-        std::swap(del_, other.del_);
+        std::swap(GetDeleter(), other.GetDeleter());
     }
 
     T *Get() const noexcept {
@@ -95,5 +138,225 @@ public:
     UniquePtr &operator=(UniquePtr &) = delete;
 
     T *ptr_;
-    Deleter del_;
 };
+
+// Array form: delete[]-based default deleter and operator[] instead of
+// dereference, so raw buffers can live in the same type family.
+template <typename T, typename Deleter>
+class UniquePtr<T[], Deleter> : private DeleterHolder<Deleter>, private UniqueHandleTracker {
+public:
+    UniquePtr() noexcept : ptr_(nullptr) {
+    }
+
+    UniquePtr(T *elem) noexcept : ptr_(elem) {
+    }
+
+    UniquePtr(T *elem, Deleter d) noexcept : DeleterHolder<Deleter>(std::move(d)), ptr_(elem) {
+    }
+
+    UniquePtr(UniquePtr &&u_ptr) noexcept : ptr_(u_ptr.ptr_) {
+        GetDeleter() = u_ptr.GetDeleter();
+        u_ptr.ptr_ = nullptr;
+    }
+
+    Deleter &GetDeleter() noexcept {
+        return this->Del();
+    }
+
+    const Deleter &GetDeleter() const noexcept {
+        return this->Del();
+    }
+
+    UniquePtr &operator=(std::nullptr_t) noexcept {
+        GetDeleter()(ptr_);
+        ptr_ = nullptr;
+        return *this;
+    }
+
+    UniquePtr &operator=(UniquePtr &&u_ptr) noexcept {
+        if (u_ptr.ptr_ == ptr_) {
+            return *this;
+        }
+        GetDeleter()(ptr_);
+        ptr_ = u_ptr.ptr_;
+        GetDeleter() = u_ptr.GetDeleter();
+        u_ptr.ptr_ = nullptr;
+        return *this;
+    }
+
+    ~UniquePtr() {
+        GetDeleter()(ptr_);
+    }
+
+    T &operator[](size_t index) const {
+        return ptr_[index];
+    }
+
+    T *Release() noexcept {
+        T *temp_ptr = ptr_;
+        ptr_ = nullptr;
+        return temp_ptr;
+    }
+
+    void Reset(T *p = nullptr) noexcept {
+        std::swap(ptr_, p);
+        if (p != nullptr) {
+            GetDeleter()(p);
+        }
+    }
+
+    void Swap(UniquePtr &other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        std::swap(GetDeleter(), other.GetDeleter());
+    }
+
+    T *Get() const noexcept {
+        return ptr_;
+    }
+
+    explicit operator bool() const noexcept {
+        return !(ptr_ == nullptr);
+    }
+
+    UniquePtr(UniquePtr &) = delete;
+
+    UniquePtr &operator=(UniquePtr &) = delete;
+
+    T *ptr_;
+};
+
+// Owning handle with small-buffer storage: objects that fit in N bytes are
+// constructed inside the handle itself — no heap allocation, no pointer chase
+// to another cache line — while larger ones spill to the heap transparently.
+// Built for tiny type-erased callbacks held behind an interface type T;
+// Emplace<U>() accepts any U derived from T. Move-only, same observer surface
+// as UniquePtr. Inline storage requires U to be nothrow-move-constructible
+// (the handle's own move must relocate it); anything else goes to the heap.
+template <typename T, size_t N = 32>
+class InplacePtr {
+public:
+    InplacePtr() = default;
+
+    InplacePtr(std::nullptr_t) {
+    }
+
+    // Adopts an already-heap-allocated object, UniquePtr-style.
+    explicit InplacePtr(T *ptr) : ptr_(ptr) {
+        if (ptr_) {
+            destroy_ = [](T *p) { delete p; };
+        }
+    }
+
+    InplacePtr(InplacePtr &&other) noexcept {
+        MoveFrom(other);
+    }
+
+    InplacePtr &operator=(InplacePtr &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    InplacePtr(const InplacePtr &) = delete;
+    InplacePtr &operator=(const InplacePtr &) = delete;
+
+    ~InplacePtr() {
+        Reset();
+    }
+
+    // Constructs a U in place, inline when it fits. Returns the concrete
+    // reference so callers can finish setup without a downcast.
+    template <typename U = T, typename... Args>
+    U &Emplace(Args &&...args) {
+        static_assert(std::is_convertible_v<U *, T *>, "U must be a T");
+        Reset();
+        if constexpr (FitsInline<U>()) {
+            U *obj = ::new (static_cast<void *>(buf_)) U(std::forward<Args>(args)...);
+            ptr_ = obj;
+            destroy_ = [](T *p) { static_cast<U *>(p)->~U(); };
+            relocate_ = [](T *src, void *dst) -> T * {
+                U *from = static_cast<U *>(src);
+                U *to = ::new (dst) U(std::move(*from));
+                from->~U();
+                return to;
+            };
+        } else {
+            U *obj = new U(std::forward<Args>(args)...);
+            ptr_ = obj;
+            // Deletes through the concrete type, so no virtual destructor is
+            // required of the interface.
+            destroy_ = [](T *p) { delete static_cast<U *>(p); };
+        }
+        return *static_cast<U *>(ptr_);
+    }
+
+    void Reset() {
+        if (ptr_) {
+            destroy_(ptr_);
+        }
+        ptr_ = nullptr;
+        destroy_ = nullptr;
+        relocate_ = nullptr;
+    }
+
+    T *Get() const noexcept {
+        return ptr_;
+    }
+
+    T &operator*() const {
+        return *ptr_;
+    }
+
+    T *operator->() const noexcept {
+        return ptr_;
+    }
+
+    explicit operator bool() const noexcept {
+        return ptr_ != nullptr;
+    }
+
+    bool IsInline() const noexcept {
+        return relocate_ != nullptr;
+    }
+
+private:
+    template <typename U>
+    static constexpr bool FitsInline() {
+        return sizeof(U) <= N && alignof(U) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<U>;
+    }
+
+    void MoveFrom(InplacePtr &other) noexcept {
+        if (!other.ptr_) {
+            return;
+        }
+        if (other.relocate_) {
+            ptr_ = other.relocate_(other.ptr_, buf_);
+            destroy_ = other.destroy_;
+            relocate_ = other.relocate_;
+        } else {
+            // Heap-backed: steal the pointer outright.
+            ptr_ = other.ptr_;
+            destroy_ = other.destroy_;
+        }
+        other.ptr_ = nullptr;
+        other.destroy_ = nullptr;
+        other.relocate_ = nullptr;
+    }
+
+    T *ptr_ = nullptr;
+    void (*destroy_)(T *) = nullptr;
+    // Move-constructs into a new buffer and destroys the source; set only
+    // for inline objects.
+    T *(*relocate_)(T *, void *) = nullptr;
+    alignas(std::max_align_t) unsigned char buf_[N];
+};
+
+template <typename T, size_t N = 32, typename U = T, typename... Args>
+InplacePtr<T, N> MakeInplace(Args &&...args) {
+    InplacePtr<T, N> ptr;
+    ptr.template Emplace<U>(std::forward<Args>(args)...);
+    return ptr;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "shared.h"
+
+#include <array>
+#include <functional>  // std::hash
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Interning cache with weak values: GetOrCreate() hands out SharedPtrs, but
+// the cache itself holds only WeakPtr entries, so a value dies the moment its
+// last outside owner drops it — no manual purge keeps dead objects pinned.
+// Keys hash into independently locked shards, so concurrent interning from
+// many threads only collides when it hits the same shard, not a global lock.
+//
+// The shard lock is held across the factory call: for a given key the factory
+// runs at most once per generation, which is the point of interning. Keep
+// factories cheap relative to what they deduplicate.
+template <typename Key, typename T, typename Policy = MultiThreaded,
+          typename Hash = std::hash<Key>, size_t NumShards = 32>
+class WeakCache {
+public:
+    WeakCache() = default;
+
+    WeakCache(const WeakCache&) = delete;
+    WeakCache& operator=(const WeakCache&) = delete;
+
+    // Returns the live value for `key`, reviving it from the weak entry when
+    // some owner still holds it; otherwise runs `factory()` (which must
+    // return a SharedPtr<T, Policy>) and caches the result weakly.
+    template <typename Factory>
+    SharedPtr<T, Policy> GetOrCreate(const Key& key, Factory&& factory) {
+        Shard& shard = ShardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            if (SharedPtr<T, Policy> alive = it->second.Lock(); alive.Get()) {
+                return alive;
+            }
+        }
+        SharedPtr<T, Policy> created = factory();
+        if (it != shard.entries.end()) {
+            it->second = WeakPtr<T, Policy>(created);
+        } else {
+            shard.entries.emplace(key, WeakPtr<T, Policy>(created));
+        }
+        return created;
+    }
+
+    // The live value for `key`, or an empty SharedPtr when absent or expired.
+    SharedPtr<T, Policy> Get(const Key& key) const {
+        const Shard& shard = ShardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            return SharedPtr<T, Policy>();
+        }
+        return it->second.Lock();
+    }
+
+    // Sweeps out entries whose values have died; returns how many were
+    // dropped. Expired entries cost only map slots, so calling this is
+    // housekeeping, not correctness.
+    size_t Purge() {
+        size_t dropped = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+                if (it->second.Expired()) {
+                    it = shard.entries.erase(it);
+                    ++dropped;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return dropped;
+    }
+
+    // Entry count including not-yet-purged expired ones.
+    size_t Size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, WeakPtr<T, Policy>, Hash> entries;
+    };
+
+    Shard& ShardFor(const Key& key) {
+        return shards_[Hash{}(key) % NumShards];
+    }
+    const Shard& ShardFor(const Key& key) const {
+        return shards_[Hash{}(key) % NumShards];
+    }
+
+    std::array<Shard, NumShards> shards_;
+};
@@ -1,10 +1,17 @@
+#include "atomic_shared.h"
 #include "intrusive.h"
+#include "pool.h"
+#include "snapshot.h"
+#include "unique.h"
 
 #include <catch.hpp>
 
 #include "allocations_checker.h"
 
+#include <atomic>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -263,80 +270,79 @@ TEST_CASE("No copies") {
     IntrusivePtr<Pinned> p(new Pinned(1));
 }
 
-template <typename T>
-class ObjectInPool;
-
-template <typename T>
-class ObjectPool {
-    static_assert(std::is_base_of_v<ObjectInPool<T>, T>, "Unsupported type");
+TEST_CASE("UniquePtr size") {
+    // A stateless deleter must not take up storage.
+    static_assert(sizeof(UniquePtr<MyInt>) == sizeof(void*));
+    static_assert(sizeof(UniquePtr<std::string>) == sizeof(void*));
 
-public:
-    template <typename... Args>
-    IntrusivePtr<T> Allocate(Args&&... args) {
-        if (!objects_.empty()) {
-            std::unique_ptr<T> ptr = std::move(objects_.back());
-            objects_.pop_back();
-            return IntrusivePtr<T>(ptr.release());
+    struct StatefulDelete {
+        int fd;
+        void operator()(MyInt* ptr) const {
+            delete ptr;
         }
-        return DoAllocate(std::forward<Args>(args)...);
-    }
-
-    void Release(T* ptr) {
-        objects_.emplace_back(ptr);
-    }
-
-    size_t NumAvailable() const {
-        return objects_.size();
-    }
-
-    size_t NumInUse() const {
-        return allocated_ - NumAvailable();
-    }
+    };
+    static_assert(sizeof(UniquePtr<MyInt, StatefulDelete>) > sizeof(void*));
 
-private:
-    template <typename... Args>
-    IntrusivePtr<T> DoAllocate(Args&&... args) {
-        ++allocated_;
-        std::unique_ptr<T> object = std::make_unique<T>(std::forward<Args>(args)...);
-        object->SetHome(this);
-        return IntrusivePtr<T>(object.release());
-    }
+    UniquePtr<MyInt> p(new MyInt(7));
+    REQUIRE(p->value == 7);
+    p.Reset();
+    REQUIRE(!p);
+}
 
-private:
-    std::vector<std::unique_ptr<T>> objects_;
-    size_t allocated_ = 0;
-};
+TEST_CASE("UniquePtr arrays") {
+    static_assert(sizeof(UniquePtr<int[]>) == sizeof(void*));
 
-template <typename Derived>
-class ObjectInPool {
-public:
-    void IncRef() {
-        count_++;
+    UniquePtr<int[]> buf(new int[16]);
+    for (int i = 0; i < 16; ++i) {
+        buf[i] = i * i;
     }
+    REQUIRE(buf[3] == 9);
+    REQUIRE(buf.Get() + 4 == &buf[4]);
+
+    UniquePtr<int[]> other(std::move(buf));
+    REQUIRE(!buf);
+    REQUIRE(other[15] == 225);
+    other.Reset(new int[4]);
+    other = nullptr;
+    REQUIRE(!other);
+}
 
-    void DecRef() {
-        if (--count_ == 0) {
-            TakeMeHome();
+TEST_CASE("InplacePtr") {
+    struct Callback {
+        virtual ~Callback() = default;
+        virtual int Run() = 0;
+    };
+    struct Doubler : Callback {
+        int v;
+        explicit Doubler(int v) : v(v) {
         }
-    }
+        Doubler(Doubler&&) noexcept = default;
+        int Run() override {
+            return v * 2;
+        }
+    };
+    struct Fat : Callback {
+        char pad[128] = {};
+        int Run() override {
+            return 1;
+        }
+    };
 
-    size_t RefCount() const {
-        return count_;
-    }
+    InplacePtr<Callback> cb;
+    REQUIRE(!cb);
 
-    void SetHome(ObjectPool<Derived>* pool) {
-        home_ = pool;
-    }
+    EXPECT_ZERO_ALLOCATIONS(cb.Emplace<Doubler>(21););
+    REQUIRE(cb.IsInline());
+    REQUIRE(cb->Run() == 42);
 
-private:
-    void TakeMeHome() {
-        home_->Release(static_cast<Derived*>(this));
-    }
+    cb.Emplace<Fat>();  // too big for the buffer: spills to the heap
+    REQUIRE(!cb.IsInline());
+    REQUIRE(cb->Run() == 1);
 
-private:
-    size_t count_ = 0;
-    ObjectPool<Derived>* home_;
-};
+    InplacePtr<Callback> moved(std::move(cb));
+    REQUIRE(!cb);
+    REQUIRE(moved->Run() == 1);
+}
 
 struct PoolableString : ObjectInPool<PoolableString>, std::string {
     using std::string::basic_string;
@@ -385,5 +391,307 @@ TEST_CASE("Object pool") {
         REQUIRE(strs.NumAvailable() == 3);
         REQUIRE(strs.NumInUse() == 1);
     }
+
+    SECTION("Reserve") {
+        strs.Reserve(3, "warm");
+        REQUIRE(strs.NumAvailable() == 3);
+        REQUIRE(strs.NumInUse() == 0);
+
+        EXPECT_ZERO_ALLOCATIONS(auto a = strs.Allocate("aa"); auto b = strs.Allocate("bb");
+                                auto c = strs.Allocate("cc"); REQUIRE(*a == "warm"););
+
+        strs.Reserve(3);  // already warm, no-op
+        REQUIRE(strs.NumAvailable() == 3);
+    }
+
+    SECTION("Max idle") {
+        strs.SetMaxIdle(2);
+        {
+            auto a = strs.Allocate("aa");
+            auto b = strs.Allocate("bb");
+            auto c = strs.Allocate("cc");
+            auto d = strs.Allocate("dd");
+        }
+        REQUIRE(strs.NumAvailable() == 2);
+        REQUIRE(strs.NumInUse() == 0);
+    }
+
+    SECTION("Batch release") {
+        std::vector<PoolableString*> burst;
+        for (int i = 0; i < 5; ++i) {
+            burst.push_back(new PoolableString("bulk"));
+        }
+        strs.ReleaseBatch(burst);
+        REQUIRE(strs.NumAvailable() == 5);
+        REQUIRE(strs.NumInUse() == 0);
+        EXPECT_ZERO_ALLOCATIONS(auto a = strs.Allocate("aa"); REQUIRE(*a == "bulk"););
+    }
+
+    SECTION("ShrinkToFit") {
+        strs.Reserve(5, "idle");
+        strs.ShrinkToFit(1);
+        REQUIRE(strs.NumAvailable() == 1);
+        strs.ShrinkToFit();
+        REQUIRE(strs.NumAvailable() == 0);
+        REQUIRE(strs.NumInUse() == 0);
+    }
+}
+
+struct TrackedInt : ObjectCounters<TrackedInt> {
+    int value;
+
+    explicit TrackedInt(int value) : value(value) {
+    }
+};
+
+TEST_CASE("AtomicSharedPtr") {
+    TrackedInt::ResetCounters();
+
+    SECTION("Empty") {
+        AtomicSharedPtr<TrackedInt> holder;
+        REQUIRE(holder.Load().Get() == nullptr);
+    }
+
+    SECTION("Load and Store") {
+        AtomicSharedPtr<TrackedInt> holder(MakeShared<TrackedInt>(1));
+        SharedPtr<TrackedInt> first = holder.Load();
+        REQUIRE(first->value == 1);
+        REQUIRE(first.UseCount() == 2);  // the holder plus our copy
+
+        holder.Store(MakeShared<TrackedInt>(2));
+        REQUIRE(holder.Load()->value == 2);
+        // The old version lives exactly as long as handles to it do.
+        REQUIRE(TrackedInt::NumAlive() == 2);
+        first.Reset();
+        REQUIRE(TrackedInt::NumAlive() == 1);
+    }
+
+    SECTION("Exchange") {
+        AtomicSharedPtr<TrackedInt> holder(MakeShared<TrackedInt>(1));
+        SharedPtr<TrackedInt> previous = holder.Exchange(MakeShared<TrackedInt>(2));
+        REQUIRE(previous->value == 1);
+        REQUIRE(holder.Load()->value == 2);
+
+        previous = holder.Exchange(SharedPtr<TrackedInt>());
+        REQUIRE(previous->value == 2);
+        REQUIRE(holder.Load().Get() == nullptr);
+    }
+
+    SECTION("CompareExchange success") {
+        AtomicSharedPtr<TrackedInt> holder(MakeShared<TrackedInt>(1));
+        SharedPtr<TrackedInt> expected = holder.Load();
+        REQUIRE(holder.CompareExchange(expected, MakeShared<TrackedInt>(2)));
+        REQUIRE(holder.Load()->value == 2);
+    }
+
+    SECTION("CompareExchange failure refreshes expected") {
+        AtomicSharedPtr<TrackedInt> holder(MakeShared<TrackedInt>(1));
+        SharedPtr<TrackedInt> stale = holder.Load();
+        holder.Store(MakeShared<TrackedInt>(2));
+        REQUIRE(!holder.CompareExchange(stale, MakeShared<TrackedInt>(3)));
+        REQUIRE(stale->value == 2);  // refreshed with the current value
+        REQUIRE(holder.Load()->value == 2);
+    }
+
+    SECTION("Null transitions") {
+        AtomicSharedPtr<TrackedInt> holder;
+        SharedPtr<TrackedInt> expected;  // null matches the empty holder
+        REQUIRE(holder.CompareExchange(expected, MakeShared<TrackedInt>(1)));
+        REQUIRE(holder.Load()->value == 1);
+
+        SharedPtr<TrackedInt> null_again;  // null no longer matches
+        REQUIRE(!holder.CompareExchange(null_again, MakeShared<TrackedInt>(2)));
+        REQUIRE(null_again->value == 1);
+    }
+
+    REQUIRE(TrackedInt::NumAlive() == 0);
+}
+
+TEST_CASE("MakeSharedBatch") {
+    TrackedInt::ResetCounters();
+    // The generators return plain ints so every counted object is built in
+    // place in its slot, keeping NumAlive() exact.
+    auto gen = [](size_t i) { return static_cast<int>(i); };
+
+    SECTION("One arena backs every slot") {
+        auto batch = MakeSharedBatch<TrackedInt>(8, gen);
+        REQUIRE(batch.size() == 8);
+        REQUIRE(TrackedInt::NumAlive() == 8);
+
+        // A fixed stride from one backing allocation — no per-slot round
+        // trips; the handle vector is the call's only other allocation.
+        const char* base = reinterpret_cast<const char*>(batch[0].Get());
+        ptrdiff_t stride = reinterpret_cast<const char*>(batch[1].Get()) - base;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            REQUIRE(reinterpret_cast<const char*>(batch[i].Get()) ==
+                    base + static_cast<ptrdiff_t>(i) * stride);
+            REQUIRE(batch[i]->value == static_cast<int>(i));
+        }
+        EXPECT_ZERO_ALLOCATIONS(SharedPtr<TrackedInt> copy = batch[3]; copy.Reset(););
+    }
+
+    SECTION("Slots die independently, the arena with the last of them") {
+        auto batch = MakeSharedBatch<TrackedInt>(4, gen);
+        WeakPtr<TrackedInt> weak(batch[0]);
+
+        batch[0].Reset();
+        REQUIRE(TrackedInt::NumAlive() == 3);  // only slot 0's object died
+        REQUIRE(weak.Expired());
+
+        batch.clear();
+        REQUIRE(TrackedInt::NumAlive() == 0);
+        // The weak reference still pins slot 0's block and with it the whole
+        // arena; this release is what frees the allocation (the sanitizers
+        // own that assertion).
+        weak.Reset();
+    }
+
+    SECTION("A throwing generator unwinds cleanly") {
+        auto boom = [](size_t i) -> int {
+            if (i == 2) {
+                throw std::runtime_error("boom");
+            }
+            return static_cast<int>(i);
+        };
+        REQUIRE_THROWS_AS(MakeSharedBatch<TrackedInt>(4, boom), std::runtime_error);
+        // The two built slots were destroyed by the unwinding handles; the
+        // unbuilt share of the arena count was given back, freeing it.
+        REQUIRE(TrackedInt::NumAlive() == 0);
+    }
+
+    SECTION("Empty batch") {
+        REQUIRE(MakeSharedBatch<TrackedInt>(0, gen).empty());
+    }
+}
+
+// Scopes the thread-local opt-in so a failed assertion cannot leak deferral
+// into the tests that follow.
+struct DeferredScope {
+    DeferredScope() {
+        SetDeferredReclaim(true);
+    }
+    ~DeferredScope() {
+        SetDeferredReclaim(false);
+    }
+};
+
+TEST_CASE("Deferred reclaim") {
+    TrackedInt::ResetCounters();
+
+    SECTION("Zero strong pushes instead of destroying") {
+        DeferredScope deferred;
+        SharedPtr<TrackedInt> p = MakeShared<TrackedInt>(1);
+        p.Reset();
+        REQUIRE(TrackedInt::NumAlive() == 1);  // parked on the queue
+        REQUIRE(DrainDeferred() == 1);
+        REQUIRE(TrackedInt::NumAlive() == 0);
+    }
+
+    SECTION("Weak promotion fails while destruction is pending") {
+        DeferredScope deferred;
+        SharedPtr<TrackedInt> p = MakeShared<TrackedInt>(1);
+        WeakPtr<TrackedInt> weak(p);
+        p.Reset();
+        REQUIRE(!weak.Lock());  // dead, even though not yet destroyed
+        REQUIRE(DrainDeferred() == 1);
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Drain runs cascades iteratively") {
+        struct Link : ObjectCounters<Link> {
+            SharedPtr<Link> next;
+        };
+        {
+            DeferredScope deferred;
+            SharedPtr<Link> head = MakeShared<Link>();
+            head->next = MakeShared<Link>();
+            head->next->next = MakeShared<Link>();
+            head.Reset();
+            REQUIRE(Link::NumAlive() == 3);
+            // Destroying each link enqueues the next; one drain reaps all.
+            REQUIRE(DrainDeferred() == 3);
+            REQUIRE(Link::NumAlive() == 0);
+        }
+    }
+
+    SECTION("Drains on a thread that never opted in") {
+        {
+            DeferredScope deferred;
+            MakeShared<TrackedInt>(1);
+            REQUIRE(TrackedInt::NumAlive() == 1);
+        }
+        size_t reclaimed = 0;
+        std::thread([&] { reclaimed = DrainDeferred(); }).join();
+        REQUIRE(reclaimed == 1);
+        REQUIRE(TrackedInt::NumAlive() == 0);
+    }
+}
+
+TEST_CASE("Snapshot") {
+    TrackedInt::ResetCounters();
+
+    SECTION("Pin keeps a retired version alive") {
+        SnapshotSource<TrackedInt> source(MakeShared<TrackedInt>(1));
+        SnapshotPtr<TrackedInt> snap = source.Snapshot();
+        REQUIRE(snap->value == 1);
+
+        source.Store(MakeShared<TrackedInt>(2));
+        REQUIRE(source.Snapshot()->value == 2);
+        // The old version is retired, not freed: our pin predates it.
+        REQUIRE(source.NumRetired() == 1);
+        REQUIRE(source.ReclaimRetired() == 0);
+        REQUIRE(snap->value == 1);
+        REQUIRE(TrackedInt::NumAlive() == 2);
+
+        snap.Reset();
+        REQUIRE(source.ReclaimRetired() == 1);
+        REQUIRE(TrackedInt::NumAlive() == 1);
+    }
+
+    SECTION("Nested pins share one announcement") {
+        SnapshotSource<TrackedInt> source(MakeShared<TrackedInt>(1));
+        SnapshotPtr<TrackedInt> outer = source.Snapshot();
+        SnapshotPtr<TrackedInt> inner = source.Snapshot();
+        source.Store(MakeShared<TrackedInt>(2));
+
+        inner.Reset();  // the outer pin still protects the old version
+        REQUIRE(source.ReclaimRetired() == 0);
+        REQUIRE(outer->value == 1);
+
+        outer.Reset();
+        REQUIRE(source.ReclaimRetired() == 1);
+    }
+
+    SECTION("Unpinned stores sweep inline") {
+        SnapshotSource<TrackedInt> source(MakeShared<TrackedInt>(1));
+        source.Store(MakeShared<TrackedInt>(2));  // nobody pinned
+        REQUIRE(source.NumRetired() == 0);
+        REQUIRE(TrackedInt::NumAlive() == 1);
+    }
+
+    SECTION("Cross-thread move releases the origin pin") {
+        SnapshotSource<TrackedInt> source(MakeShared<TrackedInt>(1));
+        SnapshotPtr<TrackedInt> snap = source.Snapshot();
+        source.Store(MakeShared<TrackedInt>(2));
+
+        // Destroying a moved snapshot on another thread must unpin the slot
+        // that took the pin, not the destroyer's.
+        std::atomic<int> seen{0};
+        std::thread([&, moved = std::move(snap)]() mutable {
+            seen = moved->value;
+            moved.Reset();
+        }).join();
+        REQUIRE(seen == 1);
+        REQUIRE(source.ReclaimRetired() == 1);
+
+        // And this thread's own slot still pins correctly afterwards.
+        SnapshotPtr<TrackedInt> again = source.Snapshot();
+        source.Store(MakeShared<TrackedInt>(3));
+        REQUIRE(source.ReclaimRetired() == 0);
+        again.Reset();
+        REQUIRE(source.ReclaimRetired() == 1);
+    }
+
+    REQUIRE(TrackedInt::NumAlive() == 0);
 }
 
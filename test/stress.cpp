@@ -0,0 +1,366 @@
+// Stress and contention harness for the concurrent counting modes.
+// Standalone binary (own main, no test framework) so it can run under TSan
+// and ASan directly:
+//
+//   g++ -std=c++17 -O1 -fsanitize=thread -Isrc test/stress.cpp -pthread -mcx16 -latomic
+//   g++ -std=c++17 -O1 -fsanitize=address,undefined -Isrc test/stress.cpp -pthread -mcx16 -latomic
+//
+// Phase 1 hammers copy/move/Reset/Lock on shared SharedPtr/WeakPtr instances
+// with randomized interleavings (seed printed for replay; pass it as argv[1])
+// and checks counter integrity afterwards. Phase 2 reports copy+destroy
+// throughput on one contended control block from 1 to 64 threads, for the
+// MultiThreaded and Biased policies — the scaling curves that pick the
+// counting mode per service.
+
+#include "atomic_shared.h"
+#include "shared.h"
+#include "snapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<long> nodes_alive{0};
+
+struct Node {
+    long value;
+
+    explicit Node(long v) : value(v) {
+        nodes_alive.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~Node() {
+        nodes_alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Phase 1: randomized interleavings.
+//
+// Individual SharedPtr instances are not thread-safe, so the shared state is
+// a set of slots that threads only copy from / Lock, plus a mutex-guarded
+// mailbox that migrates whole handles between threads — that is what forces
+// cross-thread destruction, the interesting path for the Biased policy. The
+// calling thread created the slots, so it runs the op mix too: for Biased
+// that is the owner thread, and its Increment/Decrement/Lock interleavings
+// against foreign traffic are exactly the owner-local paths under test.
+
+template <class Policy>
+void StressPolicy(const char* name, unsigned seed, int num_threads, int ops_per_thread) {
+    constexpr int kSlots = 16;
+
+    std::vector<SharedPtr<Node, Policy>> slots;
+    std::vector<WeakPtr<Node, Policy>> weaks;
+    for (int i = 0; i < kSlots; ++i) {
+        slots.push_back(MakeShared<Node, Policy>(i));
+        weaks.emplace_back(slots.back());
+    }
+
+    std::mutex mailbox_mutex;
+    std::vector<SharedPtr<Node, Policy>> mailbox;
+
+    std::atomic<long> lock_failures{0};
+    std::atomic<long> sink{0};  // keeps payload reads observable
+    auto hammer = [&](unsigned thread_seed) {
+        std::mt19937 rng(thread_seed);
+        std::vector<SharedPtr<Node, Policy>> local;
+        std::vector<WeakPtr<Node, Policy>> local_weaks;
+        long reads = 0;
+        for (int i = 0; i < ops_per_thread; ++i) {
+            switch (rng() % 9) {
+                case 0:  // copy from a shared slot
+                    local.push_back(slots[rng() % kSlots]);
+                    break;
+                case 1:  // move between local handles
+                    if (local.size() >= 2) {
+                        local[rng() % local.size()] = std::move(local[rng() % local.size()]);
+                    }
+                    break;
+                case 2:  // drop a local handle
+                    if (!local.empty()) {
+                        local[rng() % local.size()].Reset();
+                    }
+                    break;
+                case 3:  // promote a shared weak; slots stay alive, so
+                         // failures mean a counting bug
+                    if (!weaks[rng() % kSlots].Lock()) {
+                        lock_failures.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                case 4:  // promote a weak of a (possibly dead) local object;
+                         // touching the payload lets ASan catch resurrection
+                    if (!local_weaks.empty()) {
+                        if (auto locked = local_weaks[rng() % local_weaks.size()].Lock()) {
+                            reads += locked->value;
+                            local.push_back(std::move(locked));
+                        }
+                    }
+                    break;
+                case 5:  // post a handle to another thread
+                    if (!local.empty()) {
+                        std::lock_guard<std::mutex> guard(mailbox_mutex);
+                        mailbox.push_back(std::move(local.back()));
+                        local.pop_back();
+                    }
+                    break;
+                case 6:  // adopt (and maybe die with) a migrated handle
+                {
+                    std::lock_guard<std::mutex> guard(mailbox_mutex);
+                    if (!mailbox.empty()) {
+                        local.push_back(std::move(mailbox.back()));
+                        mailbox.pop_back();
+                    }
+                } break;
+                case 7:  // bound the working set
+                    if (local.size() > 64) {
+                        local.clear();
+                    }
+                    if (local_weaks.size() > 64) {
+                        local_weaks.clear();
+                    }
+                    break;
+                case 8:  // create a fresh node owned by this thread; its
+                         // handles (and weaks of them) then churn through the
+                         // whole mix, so objects actually die mid-run — the
+                         // only way weak promotion races destruction
+                    local.push_back(MakeShared<Node, Policy>(i));
+                    local_weaks.emplace_back(local.back());
+                    break;
+            }
+        }
+        sink.fetch_add(reads, std::memory_order_relaxed);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(hammer, seed + t);
+    }
+    hammer(seed);  // the owner thread is one of the hammering threads
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    mailbox.clear();
+
+    bool ok = lock_failures.load() == 0 && nodes_alive.load() == kSlots;
+    for (int i = 0; ok && i < kSlots; ++i) {
+        ok = slots[i].UseCount() == 1 && !weaks[i].Expired();
+    }
+    slots.clear();
+    ok = ok && nodes_alive.load() == 0;
+    std::printf("stress %-13s seed=%u threads=%d ops=%d : %s\n", name, seed, num_threads,
+                ops_per_thread, ok ? "OK" : "FAILED");
+    if (!ok) {
+        std::exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Phase 1b: AtomicSharedPtr under concurrent readers and writers. Unlike the
+// slots above, here the holders themselves are the contended objects: every
+// thread loads, stores, exchanges and compare-exchanges the same cells, which
+// hammers the split external/internal counting that keeps Load() lock-free
+// against writers retiring nodes mid-pin.
+
+template <class Policy>
+void StressAtomic(const char* name, unsigned seed, int num_threads, int ops_per_thread) {
+    constexpr int kCells = 4;
+    AtomicSharedPtr<Node, Policy> cells[kCells];
+    for (int i = 0; i < kCells; ++i) {
+        cells[i].Store(MakeShared<Node, Policy>(i));
+    }
+
+    std::atomic<long> sink{0};  // keeps payload reads observable
+    auto hammer = [&](unsigned thread_seed) {
+        std::mt19937 rng(thread_seed);
+        long reads = 0;
+        for (int i = 0; i < ops_per_thread; ++i) {
+            auto& cell = cells[rng() % kCells];
+            switch (rng() % 4) {
+                case 0:  // read through the pin; the payload access lets ASan
+                         // catch a node retired out from under a reader
+                    if (auto p = cell.Load()) {
+                        reads += p->value;
+                    }
+                    break;
+                case 1:
+                    cell.Store(MakeShared<Node, Policy>(i));
+                    break;
+                case 2:
+                    if (auto old = cell.Exchange(MakeShared<Node, Policy>(i))) {
+                        reads += old->value;
+                    }
+                    break;
+                case 3: {  // CAS against a fresh load; failures mean another
+                          // writer won, which is fine — the swap must not tear
+                    auto expected = cell.Load();
+                    cell.CompareExchange(expected, MakeShared<Node, Policy>(i));
+                } break;
+            }
+        }
+        sink.fetch_add(reads, std::memory_order_relaxed);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(hammer, seed + t);
+    }
+    hammer(seed);  // owner-thread traffic, as in Phase 1
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Quiesced: each cell holds exactly one live node, and dropping the
+    // holders' references must free them all.
+    bool ok = nodes_alive.load() == kCells;
+    for (int i = 0; ok && i < kCells; ++i) {
+        ok = cells[i].Load().UseCount() == 2;  // the cell plus our copy
+    }
+    for (int i = 0; i < kCells; ++i) {
+        cells[i].Store(SharedPtr<Node, Policy>());
+    }
+    ok = ok && nodes_alive.load() == 0;
+    std::printf("atomic %-13s seed=%u threads=%d ops=%d : %s\n", name, seed, num_threads,
+                ops_per_thread, ok ? "OK" : "FAILED");
+    if (!ok) {
+        std::exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Phase 1c: epoch-pinned snapshots against storing writers. Readers take raw
+// pinned views (reclaiming a version under one is a use-after-free ASan will
+// see), the mailbox migrates pinned views so they are dropped on a thread
+// other than the one that pinned them, and any thread occasionally plays
+// writer. Views still in the mailbox when the workers exit are dropped by the
+// main thread afterwards, which exercises the orphaned-slot handoff.
+
+template <class Policy>
+void StressSnapshot(const char* name, unsigned seed, int num_threads, int ops_per_thread) {
+    SnapshotSource<Node, Policy> source(MakeShared<Node, Policy>(0));
+
+    std::mutex mailbox_mutex;
+    std::vector<SnapshotPtr<Node>> mailbox;
+
+    std::atomic<long> sink{0};  // keeps payload reads observable
+    auto hammer = [&](unsigned thread_seed) {
+        std::mt19937 rng(thread_seed);
+        long reads = 0;
+        for (int i = 0; i < ops_per_thread; ++i) {
+            switch (rng() % 8) {
+                default: {  // mostly reads, the case the scheme is built for
+                    SnapshotPtr<Node> snap = source.Snapshot();
+                    reads += snap->value;
+                    break;
+                }
+                case 5:  // post a pinned view to another thread
+                {
+                    std::lock_guard<std::mutex> guard(mailbox_mutex);
+                    mailbox.push_back(source.Snapshot());
+                } break;
+                case 6:  // adopt a view pinned elsewhere and unpin it here
+                {
+                    SnapshotPtr<Node> adopted;
+                    {
+                        std::lock_guard<std::mutex> guard(mailbox_mutex);
+                        if (!mailbox.empty()) {
+                            adopted = std::move(mailbox.back());
+                            mailbox.pop_back();
+                        }
+                    }
+                    if (adopted) {
+                        reads += adopted->value;
+                    }
+                } break;
+                case 7:  // the rare writer: publish a replacement version
+                    source.Store(MakeShared<Node, Policy>(i));
+                    break;
+            }
+        }
+        sink.fetch_add(reads, std::memory_order_relaxed);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(hammer, seed + t);
+    }
+    hammer(seed);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    mailbox.clear();  // drops pins taken by now-exited threads
+
+    // With every pin released, retiring the last version must drain it all.
+    source.Store(SharedPtr<Node, Policy>());
+    source.ReclaimRetired();
+    bool ok = source.NumRetired() == 0 && nodes_alive.load() == 0;
+    std::printf("snapshot %-11s seed=%u threads=%d ops=%d : %s\n", name, seed, num_threads,
+                ops_per_thread, ok ? "OK" : "FAILED");
+    if (!ok) {
+        std::exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Phase 2: contended copy+destroy throughput, 1..64 threads on one block.
+
+template <class Policy>
+void ScalePolicy(const char* name, int ops_per_thread) {
+    std::printf("scaling %-13s (copy+destroy one shared block, Mops/s total)\n", name);
+    for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+        SharedPtr<Node, Policy> shared = MakeShared<Node, Policy>(0);
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&] {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();  // don't starve peers on small machines
+                }
+                for (int i = 0; i < ops_per_thread; ++i) {
+                    SharedPtr<Node, Policy> copy = shared;
+                    (void)copy;
+                }
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double mops = num_threads * static_cast<double>(ops_per_thread) / elapsed.count() / 1e6;
+        std::printf("  threads=%2d  %8.2f\n", num_threads, mops);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned seed = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10))
+                             : std::random_device{}();
+    // Sanitizers slow everything ~10x; keep default volumes runnable there.
+    int num_threads = 8;
+    int stress_ops = 40000;
+    int scale_ops = 200000;
+
+    StressPolicy<MultiThreaded>("MultiThreaded", seed, num_threads, stress_ops);
+    StressPolicy<Biased>("Biased", seed, num_threads, stress_ops);
+    // Single-threaded counting is only safe on one thread, but the same op
+    // mix still checks the counters under randomized orderings.
+    StressPolicy<SingleThreaded>("SingleThreaded", seed, 1, stress_ops);
+
+    // Every atomic-holder op allocates, so a quarter of the volume keeps the
+    // run time in line with the phase above.
+    StressAtomic<MultiThreaded>("MultiThreaded", seed, num_threads, stress_ops / 4);
+    StressAtomic<Biased>("Biased", seed, num_threads, stress_ops / 4);
+
+    StressSnapshot<MultiThreaded>("MultiThreaded", seed, num_threads, stress_ops);
+    StressSnapshot<Biased>("Biased", seed, num_threads, stress_ops);
+
+    ScalePolicy<MultiThreaded>("MultiThreaded", scale_ops);
+    ScalePolicy<Biased>("Biased", scale_ops);
+    return 0;
+}